@@ -51,9 +51,27 @@ private:
     hardware_interface::VelocityJointInterface velocity_joint_interface;
     hardware_interface::EffortJointInterface effort_joint_interface;
 
+private:
+    /**
+     * @brief Resolve the joint addresses in the current model and the controlled joints
+     *
+     */
+    void bind();
+
 private:
     std::vector<std::string> joint_names;
 
+    // Joint addresses, -1 if the joint is not in the model
+    std::vector<int> qpos_ids;
+    std::vector<int> dof_ids;
+
+    // Joints claimed by a controller
+    std::vector<bool> controlled;
+
+    unsigned int bound_model_version = 0;
+
+    unsigned int bound_controlled_joints_version = 0;
+
     // States
     std::vector<double> joint_positions;
     std::vector<double> joint_velocities;
@@ -0,0 +1,58 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+/**
+ * @brief Messages of one publisher thread which are filled in place and published by pointer.
+ * A published message is reused once no subscriber holds it anymore, so intra-process
+ * subscribers receive it without a copy and the publisher doesn't allocate in steady state
+ *
+ * @tparam M Message type
+ */
+template <typename M>
+class MjMessagePool
+{
+public:
+    /**
+     * @brief Get a message which is not held by a subscriber, its fields keep the values of its last use
+     *
+     * @return boost::shared_ptr<M> Message to fill and publish
+     */
+    boost::shared_ptr<M> get()
+    {
+        for (const boost::shared_ptr<M> &message : messages)
+        {
+            if (message.use_count() == 1)
+            {
+                return message;
+            }
+        }
+        messages.push_back(boost::make_shared<M>());
+        return messages.back();
+    }
+
+private:
+    std::vector<boost::shared_ptr<M>> messages;
+};
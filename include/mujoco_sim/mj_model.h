@@ -22,7 +22,9 @@
 
 #include <mujoco/mujoco.h>
 
+#include <atomic>
 #include <boost/filesystem.hpp>
+#include <functional>
 #include <mutex>
 
 // MuJoCo data structures
@@ -31,6 +33,15 @@ extern mjData *d;  // MuJoCo data
 
 extern std::mutex mtx;
 
+// Number of active readers of m and d outside of mtx, by the parity of the epoch they started in
+extern std::atomic<int> model_readers[2];
+
+// Advanced by free_retired_models, readers starting after an advance can't reach the memory retired before it
+extern std::atomic<unsigned int> model_epoch;
+
+// Incremented whenever m is replaced, unlike the address of m it is never reused
+extern std::atomic<unsigned int> model_version;
+
 extern double rtf;
 
 extern std::string tmp_model_name;
@@ -47,4 +58,45 @@ extern boost::filesystem::path world_path;
 
 extern boost::filesystem::path tmp_world_path;
 
-extern std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> mesh_paths;
\ No newline at end of file
+extern std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> mesh_paths;
+
+/**
+ * @brief Scope in which m and d are read without locking mtx, memory retired during the scope is not freed while it is active.
+ * Holders of mtx don't need a scope, nothing is freed while mtx is held
+ *
+ */
+struct MjModelReader
+{
+    MjModelReader() : epoch_id(model_epoch % 2) { model_readers[epoch_id]++; }
+
+    ~MjModelReader() { model_readers[epoch_id]--; }
+
+    MjModelReader(const MjModelReader &) = delete;
+
+    void operator=(const MjModelReader &) = delete;
+
+private:
+    const unsigned int epoch_id;
+};
+
+/**
+ * @brief Hand over a free function of memory which may still be read, it will be called once no reader can still use the memory
+ *
+ * @param free_function Function to free the memory
+ */
+void retire(std::function<void()> free_function);
+
+/**
+ * @brief Hand over a replaced model, it will be freed once no reader can still use it
+ *
+ * @param m_old Replaced mjModel*
+ * @param d_old Replaced mjData*
+ */
+void retire_model(mjModel *m_old, mjData *d_old);
+
+/**
+ * @brief Free the retired models and memory once the readers which started before their retirement are gone,
+ * must be called from the simulation thread outside of a step. Does nothing while mtx is held elsewhere
+ *
+ */
+void free_retired_models();
@@ -0,0 +1,82 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "mj_model.h"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Compiled model and derived tables of the startup model, stored under model/tmp/cache
+ * and keyed by a hash of the model files and the rosparams which change the model
+ *
+ */
+class MjModelCache
+{
+public:
+    MjModelCache(const MjModelCache &) = delete;
+
+    void operator=(MjModelCache const &) = delete;
+
+    static MjModelCache &get_instance()
+    {
+        static MjModelCache mj_model_cache;
+        return mj_model_cache;
+    }
+
+public:
+    /**
+     * @brief Read the cache settings from rosparam and hash the inputs of the startup model,
+     * must be called after MjRos::set_params
+     *
+     */
+    void init();
+
+    /**
+     * @brief Load the compiled model of the current inputs and restore joint_names, mesh_paths and geom_pose
+     *
+     * @param tmp_model_xml Content of the model file tmp_model_path which m was compiled from
+     * @param cache_model_xml Content of the model file cache_model_path which m was compiled from
+     * @return mjModel* The cached model, nullptr if there is none or a dependency has changed
+     */
+    mjModel *load(std::string &tmp_model_xml, std::string &cache_model_xml);
+
+    /**
+     * @brief Store m and the derived tables of the current inputs, called after the startup model is compiled
+     *
+     * @param tmp_model_xml Content of the model file tmp_model_path which m was compiled from
+     * @param cache_model_xml Content of the model file cache_model_path which m was compiled from
+     */
+    void save(const std::string &tmp_model_xml, const std::string &cache_model_xml);
+
+private:
+    MjModelCache() = default; // Singleton
+
+    ~MjModelCache() = default;
+
+private:
+    bool enabled = true;
+
+    boost::filesystem::path cache_path;
+
+    std::string key;
+};
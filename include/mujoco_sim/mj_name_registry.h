@@ -0,0 +1,99 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "mj_model.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+class MjNameRegistry
+{
+public:
+    MjNameRegistry(const MjNameRegistry &) = delete;
+
+    void operator=(MjNameRegistry const &) = delete;
+
+    static MjNameRegistry &get_instance()
+    {
+        static MjNameRegistry mj_name_registry;
+        return mj_name_registry;
+    }
+
+public:
+    /**
+     * @brief Index the names of a new model, must be called for every model before it replaces m
+     *
+     * @param model The new model
+     */
+    void bind(const mjModel *model);
+
+    /**
+     * @brief Get the id of a name, same as mj_name2id but in constant time.
+     * The caller must hold a MjModelReader or mtx
+     *
+     * @param type Object type
+     * @param name Object name
+     * @param model The model of the name, other models than the one of the last bind are looked up with mj_name2id
+     * @return int Object id, -1 if not found
+     */
+    int get_id(const mjtObj type, const std::string &name, const mjModel *model = m) const;
+
+    /**
+     * @brief Get a name which is neither in the model nor reserved, the name is reserved until the next bind
+     *
+     * @param type Object type
+     * @param name Wanted name, a trailing "_<number>" is replaced if the name is taken
+     * @return std::string The unique name
+     */
+    std::string make_unique_name(const mjtObj type, const std::string &name);
+
+private:
+    MjNameRegistry() = default; // Singleton
+
+    ~MjNameRegistry() = default;
+
+private:
+    bool is_taken(const mjtObj type, const std::string &name) const;
+
+private:
+    struct Names
+    {
+        const mjModel *model = nullptr;
+
+        std::map<mjtObj, std::unordered_map<std::string, int>> ids;
+    };
+
+    std::atomic<Names *> names{nullptr};
+
+    std::mutex reserve_mtx;
+
+    // Names given out since the last bind
+    std::map<mjtObj, std::unordered_set<std::string>> reserved_names;
+
+    // Next number to try for every prefix
+    std::map<mjtObj, std::unordered_map<std::string, int>> prefix_counters;
+};
@@ -0,0 +1,83 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <ctime>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Keep the simulation time in sync with the wall time at a target real time factor
+ *
+ */
+class MjPacer
+{
+public:
+    /**
+     * @brief Construct a new pacer
+     *
+     * @param real_time_factor Target ratio of simulation time to wall time, <= 0 to run as fast as possible
+     * @param window_size Number of steps the real time factor is averaged over
+     */
+    MjPacer(const double real_time_factor, const size_t window_size);
+
+public:
+    /**
+     * @brief Sleep until the wall time of the simulation time is reached
+     *
+     * @param sim_time Simulation time after the step
+     * @return double Seconds the wall time is behind the simulation time, 0 if it is on time
+     */
+    double wait(const double sim_time);
+
+    /**
+     * @brief Get the real time factor over the last steps
+     *
+     */
+    double get_rtf() const;
+
+private:
+    /**
+     * @brief Restart the sync from the given simulation time, e.g. after the simulation is reset
+     *
+     */
+    void restart(const double sim_time, const timespec &now);
+
+private:
+    double real_time_factor;
+
+    timespec wall_start;
+
+    double sim_start = 0.0;
+
+    double last_sim_time = 0.0;
+
+    bool started = false;
+
+    // Ring buffer of (wall time, simulation time) of the last steps
+    std::vector<std::pair<double, double>> samples;
+
+    size_t sample_head = 0;
+
+    size_t sample_num = 0;
+
+    double rtf = 0.0;
+};
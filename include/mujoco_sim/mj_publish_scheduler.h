@@ -0,0 +1,92 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+/**
+ * @brief Run periodic publishing jobs from one queue ordered by their next deadline
+ *
+ */
+class MjPublishScheduler
+{
+public:
+    /**
+     * @brief Add a job, must be called before run
+     *
+     * @param rate Frequency of the job in wall time, jobs with rate <= 0 are ignored
+     * @param job Function of one cycle, it is never run by two threads at once
+     * @return true The job has been added or is ignored
+     * @return false The scheduler is already running
+     */
+    bool add_job(const double rate, std::function<void()> job);
+
+    /**
+     * @brief Run the jobs at their deadlines until ros shuts down
+     *
+     * @param thread_num Number of threads running the jobs, the caller is one of them
+     */
+    void run(const int thread_num);
+
+private:
+    /**
+     * @brief Take the jobs with passed deadlines one by one and run them
+     *
+     */
+    void work();
+
+private:
+    struct Job
+    {
+        std::chrono::steady_clock::duration period;
+
+        std::function<void()> function;
+    };
+
+    struct Deadline
+    {
+        std::chrono::steady_clock::time_point time;
+
+        size_t job_id;
+
+        bool operator>(const Deadline &other) const
+        {
+            return time > other.time;
+        }
+    };
+
+    // Running jobs are referenced without mtx, so jobs must not change after run is called
+    std::vector<Job> jobs;
+
+    bool running = false;
+
+    // Min-heap of the next deadline of every job which is not running
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+
+    std::mutex mtx;
+
+    std::condition_variable cv;
+};
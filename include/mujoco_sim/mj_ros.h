@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "mj_publish_scheduler.h"
 #include "mj_sim.h"
 #include "mujoco_msgs/DestroyObject.h"
 #include "mujoco_msgs/ObjectInfo.h"
@@ -27,12 +28,19 @@
 #include "mujoco_msgs/ObjectStateArray.h"
 #include "mujoco_msgs/ObjectStatus.h"
 #include "mujoco_msgs/SpawnObject.h"
+#include "mujoco_sim/DestroyObjectAsync.h"
+#include "mujoco_sim/SensorDataArray.h"
+#include "mujoco_sim/SensorNames.h"
+#include "mujoco_sim/SimStats.h"
+#include "mujoco_sim/SpawnObjectAsync.h"
+#include "mujoco_sim/SpawnStatus.h"
 
 #include <geometry_msgs/TransformStamped.h>
 #include <geometry_msgs/Twist.h>
 #include <geometry_msgs/Vector3Stamped.h>
 #include <nav_msgs/Odometry.h>
 #include <sensor_msgs/JointState.h>
+#include <std_msgs/UInt32.h>
 #include <std_srvs/Trigger.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
@@ -89,7 +97,7 @@ public:
     void init();
 
     /**
-     * @brief Setup publish threads
+     * @brief Add the publishers to the publish scheduler and run it until ros shuts down
      *
      */
     void setup_publishers();
@@ -106,6 +114,22 @@ public:
      */
     void get_controlled_joints();
 
+    /**
+     * @brief Check if the joints of a controller type count as controlled joints
+     *
+     * @param controller_type Type of the controller, e.g. position_controllers/JointPositionController
+     * @return true The type is a position, velocity, effort or the custom controller type
+     */
+    bool is_joint_controller_type(const std::string &controller_type) const;
+
+    /**
+     * @brief Publish the simulation time on /clock if the run mode is not real time,
+     * called by the simulation thread after every step
+     *
+     * @param time Time of d after the step
+     */
+    void publish_clock(const mjtNum time);
+
 public:
     static ros::Time ros_start;
     
@@ -115,6 +139,10 @@ private:
     ~MjRos();
 
 private:
+    /**
+     * @brief The publish functions add a job of the object type to the publish scheduler, EObjectType::None adds the jobs of every object type
+     *
+     */
     void publish_tf(const EObjectType object_type = EObjectType::None);
 
     void publish_marker_array(const EObjectType object_type = EObjectType::None);
@@ -125,8 +153,24 @@ private:
 
     void publish_base_pose();
 
+    /**
+     * @brief Publish the force and torque sensors, one message per sensor
+     *
+     */
     void publish_sensor_data();
 
+    /**
+     * @brief Publish the values of all sensors in one message per cycle, the names are published latched once per model
+     *
+     */
+    void publish_sensor_data_array();
+
+    /**
+     * @brief Publish the real time factor and the time the simulation thread waited for mtx
+     *
+     */
+    void publish_sim_stats();
+
     void spawn_and_destroy_objects();
 
 private:
@@ -138,9 +182,59 @@ private:
 
     void spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects);
 
+    /**
+     * @brief Spawn the objects from the pool, mtx must be locked by the caller
+     *
+     * @return std::vector<mujoco_msgs::ObjectStatus> Objects which need a recompile
+     */
+    std::vector<mujoco_msgs::ObjectStatus> claim_objects(const int nr, const std::vector<mujoco_msgs::ObjectStatus> &objects);
+
+    /**
+     * @brief Add the bodies of the objects to the xml which is compiled into the model
+     *
+     */
+    void add_object_elements(const std::vector<mujoco_msgs::ObjectStatus> &objects, tinyxml2::XMLDocument &object_xml_doc);
+
+    /**
+     * @brief Register the compiled objects and set their velocities, mtx must be locked by the caller
+     *
+     * @return true All objects are in the model
+     * @return false Some objects failed to compile
+     */
+    bool bind_spawned_objects(const int nr, const std::vector<mujoco_msgs::ObjectStatus> &objects);
+
     bool destroy_objects_service(mujoco_msgs::DestroyObjectRequest &req, mujoco_msgs::DestroyObjectResponse &res);
 
-    void destroy_objects(const std::set<std::string> object_names);
+    /**
+     * @brief Queue a spawn request and return its ticket at once, the result is published on /mujoco/spawn_status
+     *
+     */
+    bool spawn_objects_async_service(mujoco_sim::SpawnObjectAsyncRequest &req, mujoco_sim::SpawnObjectAsyncResponse &res);
+
+    /**
+     * @brief Queue a destroy request and return its ticket at once, the result is published on /mujoco/spawn_status
+     *
+     */
+    bool destroy_objects_async_service(mujoco_sim::DestroyObjectAsyncRequest &req, mujoco_sim::DestroyObjectAsyncResponse &res);
+
+    /**
+     * @brief Remove the parked bodies of soft destroyed objects from the model with one recompile
+     *
+     */
+    bool compact_service(std_srvs::TriggerRequest &req, std_srvs::TriggerResponse &res);
+
+    /**
+     * @brief Give the pooled objects back to the pool and park the soft destroyed objects, mtx must be locked by the caller
+     *
+     * @return std::set<std::string> Names of the bodies which need a recompile to be removed
+     */
+    std::set<std::string> release_objects(const std::set<std::string> &object_names);
+
+    /**
+     * @brief Unregister the destroyed objects, mtx must be locked by the caller
+     *
+     */
+    void unbind_destroyed_objects(const std::set<std::string> &object_names);
 
     void add_marker(const int body_id, const EObjectType object_type);
 
@@ -152,8 +246,16 @@ private:
 
     void set_transform(geometry_msgs::TransformStamped &transform, const int body_id, const std::string &object_name);
 
+    /**
+     * @brief Set the pose of the body from the snapshot, the frame ids are kept
+     *
+     */
+    void set_transform(geometry_msgs::TransformStamped &transform, const int body_id);
+
     void reset_robot();
 
+    void step_callback(const std_msgs::UInt32 &msg);
+
 private:
     ros::NodeHandle n;
 
@@ -163,6 +265,8 @@ private:
 
     std::map<std::string, ros::Subscriber> cmd_vel_subs;
 
+    ros::Subscriber step_sub;
+
     ros::ServiceServer screenshot_server;
 
     ros::ServiceServer reset_robot_server;
@@ -171,6 +275,12 @@ private:
 
     ros::ServiceServer destroy_objects_server;
 
+    ros::ServiceServer spawn_objects_async_server;
+
+    ros::ServiceServer destroy_objects_async_server;
+
+    ros::ServiceServer compact_server;
+
     std::map<std::string, ros::Publisher> base_pose_pubs;
 
     ros::Publisher marker_array_pub;
@@ -181,6 +291,23 @@ private:
 
     ros::Publisher sensors_pub;
 
+    ros::Publisher sensor_data_array_pub;
+
+    ros::Publisher sensor_names_pub;
+
+    ros::Publisher clock_pub;
+
+    ros::Publisher spawn_status_pub;
+
+    ros::Publisher sim_stats_pub;
+
+    // Simulation time between two /clock messages, 0 to publish after every step
+    double clock_period = 0.0;
+
+    mjtNum last_clock_time = -1.0;
+
+    MjPublishScheduler publish_scheduler;
+
     tf2_ros::TransformBroadcaster br;
 
     tf2_ros::StaticTransformBroadcaster static_br;
@@ -22,10 +22,66 @@
 
 #include "mj_model.h"
 
+#include <chrono>
 #include <map>
 #include <set>
+#include <tinyxml2.h>
 #include <vector>
 
+/**
+ * @brief Source of the joint efforts reported to the hardware interfaces and joint_states
+ *
+ */
+enum EEffortSource : std::int8_t
+{
+    InverseDynamics = 0,
+    ActuatorForce = 1,
+    JointTorqueSensor = 2
+};
+
+/**
+ * @brief How the simulation thread advances the simulation time
+ *
+ */
+enum ERunMode : std::int8_t
+{
+    // Synchronized with the wall time at real_time_factor
+    RealTime = 0,
+    // As fast as possible, the time is published on /clock
+    FreeRun = 1,
+    // Only the requested steps are taken, the time is published on /clock
+    LockStep = 2
+};
+
+/**
+ * @brief How the world meshes are staged in model/tmp, where RViz finds them
+ *
+ */
+enum EMeshStaging : std::int8_t
+{
+    Copy = 0,
+    // Falls back to a copy if the mesh is on another file system
+    Hardlink = 1,
+    Symlink = 2
+};
+
+/**
+ * @brief Odom joints of a robot, in the order lin_odom_x, lin_odom_y, lin_odom_z, ang_odom_x, ang_odom_y, ang_odom_z
+ *
+ */
+struct MjOdomPlan
+{
+    // Bit i is set if the i-th odom joint is enabled in add_odom_joints
+    unsigned int enabled = 0;
+
+    // Joint addresses, -1 if the joint is not in the model, resolved once per model
+    int qpos_ids[6] = {-1, -1, -1, -1, -1, -1};
+    int dof_ids[6] = {-1, -1, -1, -1, -1, -1};
+
+    // Velocity commands, written by the cmd_vel callback
+    std::atomic<mjtNum> cmd_vels[6];
+};
+
 class MjSim
 {
 public:
@@ -52,6 +108,15 @@ public:
      */
     void init_sensors();
 
+    /**
+     * @brief Get the name of a sensor, sensors without a name get one from their type and object
+     *
+     * @param sensor_id Id of the sensor
+     * @param model The model of the sensor
+     * @return std::string Name of the sensor
+     */
+    static std::string get_sensor_name(const int sensor_id, const mjModel *model = m);
+
     /**
      * @brief Implement the controller
      *
@@ -64,12 +129,21 @@ public:
      */
     void set_odom_vels();
 
+    /**
+     * @brief Compute the joint efforts of the current step into MjSim::efforts, called once per controller tick
+     *
+     */
+    void compute_efforts();
+
 public:
     /**
-     * @brief Spawn new data from file
+     * @brief Spawn new data, the model files are edited and compiled in memory
      *
+     * @param add_xml_doc Document whose elements are added to the model
+     * @return true Successfully added
+     * @return false Fail to add
      */
-    static bool add_data();
+    static bool add_data(tinyxml2::XMLDocument &add_xml_doc);
 
     /**
      * @brief Remove bodies with name
@@ -80,14 +154,91 @@ public:
      */
     static bool remove_body(const std::set<std::string> &body_names);
 
+    /**
+     * @brief Remove and add bodies in one model edit, the model is compiled only once
+     *
+     * @param add_xml_doc Document whose elements are added to the model, nullptr to add nothing
+     * @param remove_body_names Set of body names to remove
+     * @return true Successfully edited
+     * @return false Fail to edit, the model is left unchanged
+     */
+    static bool edit_data(tinyxml2::XMLDocument *add_xml_doc, const std::set<std::string> &remove_body_names);
+
+    /**
+     * @brief Save m as xml, also when m was loaded from the model cache
+     *
+     * @param path Path of the xml
+     * @return true Successfully saved
+     * @return false Fail to save
+     */
+    static bool save_model_xml(const char *path);
+
+    /**
+     * @brief Get model_path parsed, it is parsed on the first call and kept until the end of init()
+     *
+     * @return const tinyxml2::XMLDocument* nullptr if model_path can't be parsed
+     */
+    static const tinyxml2::XMLDocument *get_model_doc();
+
+    /**
+     * @brief Allow the simulation thread to take more steps in lockstep mode
+     *
+     * @param step_num Number of steps to add
+     */
+    static void request_steps(const unsigned int step_num);
+
+    /**
+     * @brief Take one of the requested steps, blocks for a short while if none is requested
+     *
+     * @return true A step may be taken
+     * @return false No step was requested in time
+     */
+    static bool wait_for_step();
+
+    /**
+     * @brief Account the time the simulation thread waited for mtx before a step
+     *
+     * @param stall_time Wall time waited for mtx
+     */
+    static void add_stall_time(const std::chrono::nanoseconds stall_time);
+
+    /**
+     * @brief Make a file available at a new path without copying it if possible
+     *
+     * @param file_path Path of the file
+     * @param staged_file_path Path to make the file available at, kept if it exists already
+     * @param mesh_staging How to stage the file
+     * @return true if succeed
+     */
+    static bool stage_file(const boost::filesystem::path &file_path, const boost::filesystem::path &staged_file_path, const EMeshStaging mesh_staging);
+
 public:
     static double max_time_step;
 
+    static ERunMode run_mode;
+
+    static EMeshStaging mesh_staging;
+
+    // Target ratio of simulation time to wall time, <= 0 to run as fast as possible
+    static double real_time_factor;
+
     static std::map<std::string, std::vector<std::string>> joint_names;
 
     static std::set<std::string> controlled_joints;
 
-    static std::map<std::string, mjtNum> odom_vels;
+    // Incremented whenever controlled_joints changes, only written with mtx locked
+    static std::atomic<unsigned int> controlled_joints_version;
+
+    // Wall time in ns the simulation thread waited for mtx, summed and maximum, reset by the statistics publisher
+    static std::atomic<unsigned long long> stall_time;
+    static std::atomic<unsigned long long> max_stall_time;
+
+    // Steps since the last reset of the statistics
+    static std::atomic<unsigned int> step_count;
+
+    static std::map<std::string, MjOdomPlan> odom_plans;
+
+    static const std::vector<std::string> odom_joint_names;
 
     static std::set<std::string> robot_link_names;
 
@@ -99,6 +250,11 @@ public:
 
     static mjtNum *tau;
 
+    static EEffortSource effort_source;
+
+    // Joint efforts of every dof, filled by compute_efforts
+    static mjtNum *efforts;
+
     static std::map<std::string, std::map<std::string, bool>> add_odom_joints;
 
     static std::set<std::string> robot_names;
@@ -116,6 +272,9 @@ public:
     // Fix bug from m->geom_pos and m->geom_quat
     static std::map<int, std::vector<mjtNum>> geom_pose;
 
+    // Incremented whenever geom_pose has been rebuilt, only written with mtx locked
+    static std::atomic<unsigned int> geom_pose_version;
+
 private:
     MjSim() = default;
 
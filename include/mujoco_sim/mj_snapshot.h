@@ -0,0 +1,116 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "mj_model.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief State of d exported by the simulation thread after a step
+ *
+ */
+struct MjSnapshot
+{
+    // Model the state belongs to, every dimension of the views is taken from it
+    const mjModel *model = nullptr;
+
+    // Version of the model, see model_version
+    unsigned int model_version = 0;
+
+    mjtNum time = 0.0;
+
+    // Views into data, laid out like the arrays of mjData
+    const mjtNum *xpos = nullptr;
+    const mjtNum *xquat = nullptr;
+    const mjtNum *qpos = nullptr;
+    const mjtNum *qvel = nullptr;
+    // Joint efforts of every dof, see MjSim::efforts
+    const mjtNum *efforts = nullptr;
+    const mjtNum *sensordata = nullptr;
+    const mjtNum *geom_xpos = nullptr;
+    const mjtNum *geom_xmat = nullptr;
+
+    std::vector<mjtNum> data;
+};
+
+class MjSnapshotBuffer
+{
+public:
+    MjSnapshotBuffer(const MjSnapshotBuffer &) = delete;
+
+    void operator=(MjSnapshotBuffer const &) = delete;
+
+    static MjSnapshotBuffer &get_instance()
+    {
+        static MjSnapshotBuffer mj_snapshot_buffer;
+        return mj_snapshot_buffer;
+    }
+
+public:
+    /**
+     * @brief Export the current state of d, must be called from the simulation thread with mtx locked
+     *
+     */
+    void write();
+
+    /**
+     * @brief Copy the latest exported state, never blocks the simulation thread.
+     * The caller must hold a MjModelReader
+     *
+     * @param snapshot Snapshot to copy into, its memory is reused
+     * @return true The snapshot belongs to the model of the current model_version
+     * @return false No state of the current model has been exported yet
+     */
+    bool read(MjSnapshot &snapshot) const;
+
+private:
+    MjSnapshotBuffer() = default; // Singleton
+
+    ~MjSnapshotBuffer() = default;
+
+private:
+    struct Slot
+    {
+        // Odd while the slot is being written
+        std::atomic<unsigned int> seq{0};
+
+        mjtNum time = 0.0;
+
+        std::vector<mjtNum> data;
+    };
+
+    // Triple buffer of one model, a reader of the latest slot has two steps until it is overwritten
+    struct Buffers
+    {
+        const mjModel *model = nullptr;
+
+        // The address of a freed model can be reused, its version can't
+        unsigned int model_version = 0;
+
+        Slot slots[3];
+
+        std::atomic<int> latest{-1};
+    };
+
+    std::atomic<Buffers *> buffers{nullptr};
+};
@@ -0,0 +1,246 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "mj_model.h"
+#include "mujoco_msgs/ObjectStatus.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <tinyxml2.h>
+#include <vector>
+
+/**
+ * @brief A preallocated body which can be claimed by a spawned object
+ *
+ */
+struct MjPoolSlot
+{
+    // Name of the slot body in the compiled model
+    std::string slot_name;
+
+    // Primitive geom type ("box", "sphere", "cylinder") or path of the MJCF template
+    std::string key;
+
+    bool movable = true;
+
+    // Name of the object which claims the slot, empty if the slot is free
+    std::string object_name;
+
+    // Object info of the claim, re-applied after every model load
+    mujoco_msgs::ObjectInfo info;
+
+    // Spawn pose of the claim, restored when the robot is reset
+    geometry_msgs::Pose pose;
+
+    // Rebound after every model load
+    int body_id = -1;
+
+    // Bodies in the subtree of the slot body, rebound after every model load
+    std::vector<int> body_ids;
+
+    // The slot is the body of a destroyed object, it stays in the model until the next compaction
+    bool adopted = false;
+};
+
+class MjSpawnPool
+{
+public:
+    MjSpawnPool(const MjSpawnPool &) = delete;
+
+    void operator=(MjSpawnPool const &) = delete;
+
+    static MjSpawnPool &get_instance()
+    {
+        static MjSpawnPool mj_spawn_pool;
+        return mj_spawn_pool;
+    }
+
+public:
+    /**
+     * @brief Read the pool sizes from rosparam
+     *
+     */
+    void init();
+
+    /**
+     * @brief Get the objects to spawn once at startup to fill the pool
+     *
+     * @return std::vector<mujoco_msgs::ObjectStatus> Slot objects at the parking pose
+     */
+    std::vector<mujoco_msgs::ObjectStatus> get_slot_objects() const;
+
+    /**
+     * @brief Make the slot bodies in the xml gravity compensated before compiling
+     *
+     * @param mujoco_element The root element of the xml containing the slot bodies
+     */
+    void prepare_slot_elements(tinyxml2::XMLElement *mujoco_element) const;
+
+    /**
+     * @brief Resolve the slot bodies in the current model and re-apply their states, must be called after every model compile
+     *
+     */
+    void bind();
+
+    /**
+     * @brief Put the claimed slots back to their spawn poses after d is remade,
+     * mtx must be locked by the caller
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Claim a free slot for the object and write its geometry, color and pose into m and d,
+     * mtx must be locked by the caller
+     *
+     * @param object The object to spawn
+     * @return int Body id of the claimed slot, -1 if no slot fits the object
+     */
+    int claim(const mujoco_msgs::ObjectStatus &object);
+
+    /**
+     * @brief Give the slot of the object back to the pool and park the body,
+     * mtx must be locked by the caller
+     *
+     * @param object_name Name of the spawned object
+     * @return true The object was in the pool
+     * @return false The object was not in the pool
+     */
+    bool release(const std::string &object_name);
+
+    /**
+     * @brief Park the body of a destroyed object and keep it as a free slot instead of removing it from the model,
+     * mtx must be locked by the caller
+     *
+     * @param object_name Name of the top level body of the object
+     * @param info Object info the object was spawned with
+     * @return true The body is a free slot now
+     * @return false The body can't be reused, it must be removed from the model
+     */
+    bool adopt(const std::string &object_name, const mujoco_msgs::ObjectInfo &info);
+
+    /**
+     * @brief Drop free adopted slots from the pool, the caller must remove their bodies from the model
+     *
+     * @param slot_names Names of the slots to drop, every free adopted slot if empty
+     * @return std::vector<MjPoolSlot> The dropped slots, their slot names are the names of their bodies
+     */
+    std::vector<MjPoolSlot> remove_adopted_slots(const std::set<std::string> &slot_names = {});
+
+    /**
+     * @brief Put dropped slots back into the pool when their bodies couldn't be removed from the model, needs mtx
+     *
+     * @param removed_slots Slots returned by remove_adopted_slots
+     */
+    void restore_adopted_slots(const std::vector<MjPoolSlot> &removed_slots);
+
+    /**
+     * @brief Get the fraction of the bodies in the model which belong to free adopted slots
+     *
+     */
+    double get_dead_body_ratio();
+
+    /**
+     * @brief Get the body id of a claimed object
+     *
+     * @param object_name Name of the spawned object
+     * @return int Body id, -1 if the object is not in the pool
+     */
+    int get_body_id(const std::string &object_name);
+
+    /**
+     * @brief Get the name of the object which claims the body
+     *
+     * @param body_id Body id
+     * @param object_name Name of the claiming object
+     * @return true The body is a claimed slot
+     * @return false The body is not a claimed slot
+     */
+    bool get_object_name(const int body_id, std::string &object_name);
+
+    /**
+     * @brief Check if the body belongs to a free slot (including its child bodies)
+     *
+     */
+    bool is_free_slot(const int body_id);
+
+    /**
+     * @brief Check if the name is a name of a slot body
+     *
+     */
+    bool is_slot_name(const std::string &name) const;
+
+    /**
+     * @brief Check if the name is a name of a preallocated slot body, such names can't be spawned
+     *
+     */
+    bool is_reserved_name(const std::string &name) const;
+
+    /**
+     * @brief Check if the pool has any slot
+     *
+     */
+    bool empty() const;
+
+private:
+    MjSpawnPool() = default; // Singleton
+
+    ~MjSpawnPool() = default;
+
+private:
+    void activate(const MjPoolSlot &slot);
+
+    void deactivate(const MjPoolSlot &slot);
+
+    void place(const MjPoolSlot &slot, const geometry_msgs::Pose &pose, const geometry_msgs::Twist &velocity);
+
+    std::string get_key(const mujoco_msgs::ObjectInfo &info) const;
+
+    void rebuild_ids();
+
+private:
+    mutable std::mutex pool_mtx;
+
+    std::vector<MjPoolSlot> slots;
+
+    std::map<std::string, size_t> slot_ids;
+
+    std::map<std::string, size_t> object_slot_ids;
+
+    // Free slots by key and movable
+    std::map<std::pair<std::string, bool>, std::vector<size_t>> free_slot_ids;
+
+    // Slot id of every body, -1 if the body doesn't belong to a slot
+    std::vector<int> body_slot_ids;
+
+    // Collision filters of the slot geoms as specified in the model
+    std::map<int, std::pair<int, int>> geom_collisions;
+
+    int free_slot_num = 0;
+
+    int mocap_slot_num = 0;
+
+    int template_slot_num = 0;
+
+    std::vector<std::string> templates;
+};
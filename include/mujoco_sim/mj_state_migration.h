@@ -0,0 +1,87 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include "mj_model.h"
+
+#include <vector>
+
+/**
+ * @brief Transfer of the state between two models, bodies are matched by name
+ *
+ */
+class MjStateMigration
+{
+public:
+    /**
+     * @brief Build the map from the state of m_old to the state of m_new, states of unchanged subtrees are merged into contiguous ranges
+     *
+     * @param m_old Old mjModel*
+     * @param m_new New mjModel*, its names must be in the MjNameRegistry
+     */
+    MjStateMigration(const mjModel *m_old, const mjModel *m_new);
+
+    /**
+     * @brief Copy the state of d_old into d_new
+     *
+     * @param d_old Data of m_old
+     * @param d_new Data of m_new
+     */
+    void apply(const mjData *d_old, mjData *d_new) const;
+
+private:
+    struct Range
+    {
+        int adr_old;
+
+        int adr_new;
+
+        int num;
+    };
+
+    /**
+     * @brief Add a range, merge it into the last range if both are contiguous
+     *
+     */
+    static void add_range(std::vector<Range> &ranges, const int adr_old, const int adr_new, const int num);
+
+    static void copy(const std::vector<Range> &ranges, const mjtNum *src, mjtNum *dst, const int size);
+
+    void add_joints(const int body_id_old, const int body_id_new);
+
+private:
+    const mjModel *m_old;
+
+    const mjModel *m_new;
+
+    std::vector<Range> body_ranges;
+
+    std::vector<Range> qpos_ranges;
+
+    std::vector<Range> dof_ranges;
+
+    std::vector<Range> act_ranges;
+
+    std::vector<Range> mocap_ranges;
+
+    bool copy_sensordata = false;
+};
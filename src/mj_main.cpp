@@ -23,29 +23,19 @@
 #include "mj_visual.h"
 #endif
 #include "mj_hw_interface.h"
+#include "mj_pacer.h"
 #include "mj_ros.h"
+#include "mj_snapshot.h"
 
 #include <controller_manager/controller_manager.h>
 #include <thread>
 
 static MjSim &mj_sim = MjSim::get_instance();
+static MjSnapshotBuffer &mj_snapshot_buffer = MjSnapshotBuffer::get_instance();
 #ifdef VISUAL
 static MjVisual &mj_visual = MjVisual::get_instance();
 #endif
 
-static int i = 0;
-
-#ifdef VISUAL
-// keyboard callback
-void keyboard(GLFWwindow *window, int key, int scancode, int act, int mods)
-{
-    if (act == GLFW_PRESS && key == GLFW_KEY_SPACE)
-    {
-        MjSim::add_data();
-    }
-}
-#endif
-
 void controller(const mjModel *m, mjData *d)
 {
     mj_sim.controller();
@@ -72,14 +62,27 @@ void simulate()
     spinner.start();
     ros::Time last_sim_time = MjRos::ros_start;
     double time_step = m->opt.timestep;
+    MjPacer mj_pacer(MjSim::run_mode == ERunMode::RealTime ? MjSim::real_time_factor : 0.0, mju_ceil(1 / m->opt.timestep));
+    MjRos &mj_ros = MjRos::get_instance();
 
     while (ros::ok())
     {
+        free_retired_models();
+
+        if (MjSim::run_mode == ERunMode::LockStep && !MjSim::wait_for_step())
+        {
+            continue;
+        }
+
+        mjtNum time;
         {
             ros::Time sim_time = (ros::Time)(MjRos::ros_start.toSec() + d->time);
             ros::Duration sim_period = sim_time - last_sim_time;
 
+            // Model edits and other writers hold mtx, the time waited here is the stall they cause
+            const std::chrono::steady_clock::time_point lock_start = std::chrono::steady_clock::now();
             mtx.lock();
+            MjSim::add_stall_time(std::chrono::steady_clock::now() - lock_start);
             mj_step1(m, d);
             // check if we should update the controllers
             if (sim_period.toSec() >= 1 / 10000.) // Controller with 10kHz
@@ -87,6 +90,9 @@ void simulate()
                 // store simulation time
                 last_sim_time = sim_time;
 
+                // joint efforts are shared by all hardware interfaces
+                mj_sim.compute_efforts();
+
                 // update the robot simulation with the state of the mujoco model
                 for (MjHWInterface *mj_hw_interface : mj_hw_interfaces)
                 {
@@ -109,44 +115,24 @@ void simulate()
 
             mj_sim.set_odom_vels();
 
+            mj_snapshot_buffer.write();
+
+            time = d->time;
+
             mtx.unlock();
         }
 
-        // Calculate real time factor
-        int num_step = mju_ceil(1 / m->opt.timestep);
-        static std::deque<double> last_sim_time;
-        static std::deque<double> last_ros_time;
-        double error_time;
-        double ros_time;
-        double sim_time = d->time - MjSim::sim_start;
-        if (i == 0)
-        {
-            last_sim_time.clear();
-            last_ros_time.clear();
-        }
-        do
-        {
-            ros_time = (ros::Time::now() - MjRos::ros_start).toSec();
-            error_time = ros_time - sim_time;
-        } while (error_time < -1E-6 && i != 0);
-
-        sim_time = d->time - MjSim::sim_start;
-        last_ros_time.push_front(ros_time);
-        last_sim_time.push_front(sim_time);
-        if (i == num_step)
-        {
-            double ros_time_diff = ros_time - last_ros_time.back();
-            double sim_time_diff = sim_time - last_sim_time.back();
-            rtf = sim_time_diff / ros_time_diff;
-            last_ros_time.pop_back();
-            last_sim_time.pop_back();
-        }
-        else
+        mj_ros.publish_clock(time);
+
+        // Sleep until the wall time catches up, the real time factor is averaged over one second of simulation
+        const double error_time = mj_pacer.wait(d->time - MjSim::sim_start);
+        rtf = mj_pacer.get_rtf();
+
+        // Change timestep when out of sync, the step size is kept fixed when not synchronized with the wall time
+        if (MjSim::run_mode != ERunMode::RealTime)
         {
-            i++;
+            continue;
         }
-
-        // Change timestep when out of sync
         if (error_time > 1E-3)
         {
             if (m->opt.timestep < MjSim::max_time_step)
@@ -189,7 +175,6 @@ int main(int argc, char **argv)
 #ifdef VISUAL
     ROS_INFO("Initializing OpenGL...");
     mj_visual.init();
-    glfwSetKeyCallback(mj_visual.window, keyboard);
     ROS_INFO("Initialized OpenGL successfully.");
 #endif
 
@@ -212,6 +197,7 @@ int main(int argc, char **argv)
             break;
         }
 
+        MjModelReader reader;
         if (d->time - sim_step_start > 1.0 / 60.0)
         {
             mj_visual.render(d->time - MjSim::sim_start, (ros::Time::now() - MjRos::ros_start).toSec());
@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 #include "mj_hw_interface.h"
+#include "mj_ros.h"
 
 MjHWInterface::MjHWInterface(const std::string &robot)
 {
@@ -32,6 +33,10 @@ MjHWInterface::MjHWInterface(const std::string &robot)
     joint_velocities_command.resize(num_joints, 0.);
     joint_efforts_command.resize(num_joints, 0.);
 
+    qpos_ids.resize(num_joints, -1);
+    dof_ids.resize(num_joints, -1);
+    controlled.resize(num_joints, false);
+
     for (std::size_t i = 0; i < num_joints; i++)
     {
         hardware_interface::JointStateHandle joint_state_handle(joint_names[i], &joint_positions[i], &joint_velocities[i], &joint_efforts[i]);
@@ -56,28 +61,52 @@ MjHWInterface::~MjHWInterface()
 {
 }
 
-void MjHWInterface::read()
+void MjHWInterface::bind()
 {
-    mj_inverse(m, d);
     for (std::size_t i = 0; i < joint_names.size(); i++)
     {
         const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_names[i].c_str());
-        const int qpos_id = m->jnt_qposadr[joint_id];
-        const int dof_id = m->jnt_dofadr[joint_id];
+        qpos_ids[i] = joint_id != -1 ? m->jnt_qposadr[joint_id] : -1;
+        dof_ids[i] = joint_id != -1 ? m->jnt_dofadr[joint_id] : -1;
+        controlled[i] = joint_id != -1 && MjSim::controlled_joints.find(joint_names[i]) != MjSim::controlled_joints.end();
+    }
+    bound_model_version = model_version;
+    bound_controlled_joints_version = MjSim::controlled_joints_version;
+}
+
+void MjHWInterface::read()
+{
+    if (bound_model_version != model_version || bound_controlled_joints_version != MjSim::controlled_joints_version)
+    {
+        bind();
+    }
+
+    for (std::size_t i = 0; i < joint_names.size(); i++)
+    {
+        const int qpos_id = qpos_ids[i];
+        const int dof_id = dof_ids[i];
+        if (qpos_id == -1)
+        {
+            continue;
+        }
         joint_positions[i] = d->qpos[qpos_id];
         joint_velocities[i] = d->qvel[dof_id];
-        joint_efforts[i] = d->qfrc_inverse[dof_id];
+        joint_efforts[i] = MjSim::efforts[dof_id];
     }
 }
 
 void MjHWInterface::write()
 {
+    if (bound_model_version != model_version || bound_controlled_joints_version != MjSim::controlled_joints_version)
+    {
+        bind();
+    }
+
     for (std::size_t i = 0; i < joint_names.size(); i++)
     {
-        if (MjSim::controlled_joints.find(joint_names[i]) != MjSim::controlled_joints.end())
+        if (controlled[i])
         {
-            const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_names[i].c_str());
-            const int dof_id = m->jnt_dofadr[joint_id];
+            const int dof_id = dof_ids[i];
             
             // 優先順位：位置 > 速度 > トルク
             if (mju_abs(joint_positions_command[i] - joint_positions[i]) > mjMINVAL)
@@ -103,6 +132,28 @@ void MjHWInterface::write()
 void MjHWInterface::doSwitch(const std::list<hardware_interface::ControllerInfo> &start_list,
                              const std::list<hardware_interface::ControllerInfo> &stop_list)
 {
+    // Joints become controlled as soon as their controller starts, the caller holds mtx
+    for (const hardware_interface::ControllerInfo &start_controller : start_list)
+    {
+        // Same filter as MjRos::get_controlled_joints
+        if (!MjRos::get_instance().is_joint_controller_type(start_controller.type))
+        {
+            continue;
+        }
+
+        for (const hardware_interface::InterfaceResources &interface_resource : start_controller.claimed_resources)
+        {
+            for (const std::string &joint_name : interface_resource.resources)
+            {
+                if (std::find(joint_names.begin(), joint_names.end(), joint_name) != joint_names.end() &&
+                    MjSim::controlled_joints.insert(joint_name).second)
+                {
+                    MjSim::controlled_joints_version++;
+                }
+            }
+        }
+    }
+
     for (const hardware_interface::ControllerInfo &stop_controller : stop_list)
     {
         for (const hardware_interface::InterfaceResources &interface_resource : stop_controller.claimed_resources)
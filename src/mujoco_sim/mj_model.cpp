@@ -22,12 +22,27 @@
 
 #include <ros/package.h>
 #include <tinyxml2.h>
+#include <vector>
 
 mjModel *m = NULL;
 mjData *d = NULL;
 
 std::mutex mtx;
 
+std::atomic<int> model_readers[2] = {{0}, {0}};
+
+std::atomic<unsigned int> model_epoch(0);
+
+std::atomic<unsigned int> model_version(0);
+
+static std::mutex retired_mtx;
+
+// Retired in the current epoch
+static std::vector<std::function<void()>> retired_free_functions;
+
+// Retired in the previous epoch, freed once its readers are gone
+static std::vector<std::function<void()>> expiring_free_functions;
+
 double rtf = 0.0;
 
 std::string tmp_model_name = "current.xml";
@@ -44,4 +59,61 @@ boost::filesystem::path world_path = ros::package::getPath("mujoco_sim") + "/mod
 
 boost::filesystem::path tmp_world_path = tmp_model_path;
 
-std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> mesh_paths;
\ No newline at end of file
+std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> mesh_paths;
+
+void retire(std::function<void()> free_function)
+{
+    std::lock_guard<std::mutex> lk(retired_mtx);
+    retired_free_functions.push_back(free_function);
+}
+
+void retire_model(mjModel *m_old, mjData *d_old)
+{
+    retire([m_old, d_old]()
+           {
+                if (d_old != nullptr)
+                {
+                    mj_deleteData(d_old);
+                }
+                if (m_old != nullptr)
+                {
+                    mj_deleteModel(m_old);
+                } });
+}
+
+void free_retired_models()
+{
+    // Holders of mtx read without a MjModelReader
+    std::unique_lock<std::mutex> model_lk(mtx, std::try_to_lock);
+    if (!model_lk.owns_lock())
+    {
+        return;
+    }
+
+    std::vector<std::function<void()>> free_functions;
+    {
+        std::lock_guard<std::mutex> lk(retired_mtx);
+        if (expiring_free_functions.empty())
+        {
+            if (retired_free_functions.empty())
+            {
+                return;
+            }
+
+            // Readers starting from now on count in the next epoch and only see the current memory
+            expiring_free_functions.swap(retired_free_functions);
+            model_epoch++;
+        }
+
+        if (model_readers[(model_epoch - 1) % 2] > 0)
+        {
+            return;
+        }
+        free_functions.swap(expiring_free_functions);
+    }
+
+    for (const std::function<void()> &free_function : free_functions)
+    {
+        free_function();
+    }
+}
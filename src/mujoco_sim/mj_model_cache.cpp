@@ -0,0 +1,457 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mj_model_cache.h"
+#include "mj_sim.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <ros/ros.h>
+#include <sstream>
+#include <tinyxml2.h>
+
+static const std::string cache_magic = "mujoco_sim_model_cache_1";
+
+/**
+ * @brief Add bytes to a 64-bit FNV-1a hash
+ *
+ */
+static void hash_bytes(uint64_t &hash, const void *data, const size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+static void hash_string(uint64_t &hash, const std::string &str)
+{
+    const uint64_t size = str.size();
+    hash_bytes(hash, &size, sizeof(size));
+    hash_bytes(hash, str.data(), str.size());
+}
+
+static bool read_file(const boost::filesystem::path &path, std::string &content)
+{
+    std::ifstream file(path.string(), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    content = oss.str();
+    return true;
+}
+
+template <typename T>
+static void write_value(std::ostream &os, const T &value)
+{
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::istream &is, T &value)
+{
+    return static_cast<bool>(is.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+static void write_string(std::ostream &os, const std::string &str)
+{
+    write_value(os, static_cast<uint64_t>(str.size()));
+    os.write(str.data(), str.size());
+}
+
+static bool read_string(std::istream &is, std::string &str)
+{
+    uint64_t size;
+    if (!read_value(is, size))
+    {
+        return false;
+    }
+    str.resize(size);
+    return size == 0 || static_cast<bool>(is.read(&str[0], size));
+}
+
+static void write_nums(std::ostream &os, const std::vector<mjtNum> &nums)
+{
+    write_value(os, static_cast<uint64_t>(nums.size()));
+    os.write(reinterpret_cast<const char *>(nums.data()), nums.size() * sizeof(mjtNum));
+}
+
+static bool read_nums(std::istream &is, std::vector<mjtNum> &nums)
+{
+    uint64_t size;
+    if (!read_value(is, size))
+    {
+        return false;
+    }
+    nums.resize(size);
+    return size == 0 || static_cast<bool>(is.read(reinterpret_cast<char *>(nums.data()), size * sizeof(mjtNum)));
+}
+
+/**
+ * @brief Size and modification time of a file, a changed mesh invalidates the cache
+ *
+ */
+static std::string get_file_stamp(const boost::filesystem::path &path)
+{
+    boost::system::error_code ec;
+    const uintmax_t size = boost::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return "";
+    }
+    const std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        return "";
+    }
+    return std::to_string(size) + ":" + std::to_string(mtime);
+}
+
+/**
+ * @brief Asset directories of the <compiler> elements read so far, relative paths are resolved against the main file
+ *
+ */
+struct AssetDirs
+{
+    boost::filesystem::path model_dir;
+
+    boost::filesystem::path texture_dir;
+
+    boost::filesystem::path mesh_dir;
+};
+
+static boost::filesystem::path resolve_path(const boost::filesystem::path &dir, const char *file)
+{
+    const boost::filesystem::path file_path(file);
+    return file_path.is_absolute() ? file_path : dir / file_path;
+}
+
+/**
+ * @brief Add the files a model depends on besides its meshes to the hash. Included MJCF files are hashed
+ * by content, textures, height fields and skins by their stamps. Meshes are validated by the stamps of the tables
+ *
+ */
+static void hash_model_dependencies(uint64_t &hash, const tinyxml2::XMLElement *parent_element, AssetDirs &asset_dirs, const int depth)
+{
+    // Guard against include cycles
+    if (depth > 16)
+    {
+        return;
+    }
+
+    for (const tinyxml2::XMLElement *element = parent_element->FirstChildElement();
+         element != nullptr;
+         element = element->NextSiblingElement())
+    {
+        if (strcmp(element->Value(), "compiler") == 0)
+        {
+            if (element->Attribute("assetdir") != nullptr)
+            {
+                asset_dirs.texture_dir = resolve_path(asset_dirs.model_dir, element->Attribute("assetdir"));
+                asset_dirs.mesh_dir = asset_dirs.texture_dir;
+            }
+            if (element->Attribute("texturedir") != nullptr)
+            {
+                asset_dirs.texture_dir = resolve_path(asset_dirs.model_dir, element->Attribute("texturedir"));
+            }
+            if (element->Attribute("meshdir") != nullptr)
+            {
+                asset_dirs.mesh_dir = resolve_path(asset_dirs.model_dir, element->Attribute("meshdir"));
+            }
+        }
+        else if (strcmp(element->Value(), "include") == 0 && element->Attribute("file") != nullptr)
+        {
+            const boost::filesystem::path include_path = resolve_path(asset_dirs.model_dir, element->Attribute("file"));
+            std::string content;
+            hash_string(hash, include_path.string());
+            if (read_file(include_path, content))
+            {
+                hash_string(hash, content);
+                tinyxml2::XMLDocument include_doc;
+                if (include_doc.Parse(content.c_str()) == tinyxml2::XML_SUCCESS && include_doc.FirstChildElement() != nullptr)
+                {
+                    hash_model_dependencies(hash, include_doc.FirstChildElement(), asset_dirs, depth + 1);
+                }
+            }
+            continue;
+        }
+        else if (strcmp(element->Value(), "texture") == 0)
+        {
+            for (const char *file_attribute : {"file", "fileright", "fileleft", "fileup", "filedown", "filefront", "fileback"})
+            {
+                if (element->Attribute(file_attribute) != nullptr)
+                {
+                    const boost::filesystem::path texture_path = resolve_path(asset_dirs.texture_dir, element->Attribute(file_attribute));
+                    hash_string(hash, texture_path.string());
+                    hash_string(hash, get_file_stamp(texture_path));
+                }
+            }
+        }
+        else if ((strcmp(element->Value(), "hfield") == 0 || strcmp(element->Value(), "skin") == 0) && element->Attribute("file") != nullptr)
+        {
+            const boost::filesystem::path asset_path = resolve_path(asset_dirs.mesh_dir, element->Attribute("file"));
+            hash_string(hash, asset_path.string());
+            hash_string(hash, get_file_stamp(asset_path));
+        }
+
+        hash_model_dependencies(hash, element, asset_dirs, depth);
+    }
+}
+
+void MjModelCache::init()
+{
+    if (!ros::param::get("~model_cache", enabled))
+    {
+        enabled = true;
+    }
+    if (!enabled)
+    {
+        return;
+    }
+
+    cache_path = tmp_model_path / "cache";
+
+    uint64_t hash = 14695981039346656037ULL;
+    hash_string(hash, mj_versionString());
+    std::string content;
+    for (const boost::filesystem::path &path : {model_path, world_path})
+    {
+        hash_string(hash, path.string());
+        if (read_file(path, content))
+        {
+            hash_string(hash, content);
+
+            // Included files and assets are resolved against the directory of the main file
+            tinyxml2::XMLDocument doc;
+            if (doc.Parse(content.c_str()) == tinyxml2::XML_SUCCESS && doc.FirstChildElement() != nullptr)
+            {
+                AssetDirs asset_dirs;
+                asset_dirs.model_dir = path.parent_path();
+                asset_dirs.texture_dir = asset_dirs.model_dir;
+                asset_dirs.mesh_dir = asset_dirs.model_dir;
+                hash_model_dependencies(hash, doc.FirstChildElement(), asset_dirs, 0);
+            }
+        }
+    }
+
+    hash_bytes(hash, &MjSim::disable_gravity, sizeof(MjSim::disable_gravity));
+    for (const std::string &robot : MjSim::robot_names)
+    {
+        hash_string(hash, robot);
+        for (const std::string &odom_joint_name : MjSim::odom_joint_names)
+        {
+            const bool add_odom_joint = MjSim::add_odom_joints[robot][odom_joint_name];
+            hash_bytes(hash, &add_odom_joint, sizeof(add_odom_joint));
+        }
+        if (MjSim::pose_inits.find(robot) != MjSim::pose_inits.end())
+        {
+            const std::vector<float> &pose_init = MjSim::pose_inits[robot];
+            hash_bytes(hash, pose_init.data(), pose_init.size() * sizeof(float));
+        }
+    }
+
+    XmlRpc::XmlRpcValue receive_params;
+    if (ros::param::get("~receive", receive_params))
+    {
+        hash_string(hash, receive_params.toXml());
+    }
+
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    key = oss.str();
+}
+
+mjModel *MjModelCache::load(std::string &tmp_model_xml, std::string &cache_model_xml)
+{
+    if (!enabled)
+    {
+        return nullptr;
+    }
+
+    const boost::filesystem::path mjb_path = cache_path / (key + ".mjb");
+    std::ifstream tables_file((cache_path / (key + ".tables")).string(), std::ios::binary);
+    if (!tables_file || !boost::filesystem::exists(mjb_path))
+    {
+        ROS_INFO("Model cache %s not found, compiling the model...", key.c_str());
+        return nullptr;
+    }
+
+    std::string magic;
+    if (!read_string(tables_file, magic) || magic != cache_magic)
+    {
+        ROS_WARN("Model cache %s has an unknown format, compiling the model...", key.c_str());
+        return nullptr;
+    }
+
+    // Meshes are only known after parsing, they are validated by their stamps
+    uint64_t mesh_num;
+    if (!read_value(tables_file, mesh_num))
+    {
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < mesh_num; i++)
+    {
+        std::string mesh_path, mesh_stamp;
+        if (!read_string(tables_file, mesh_path) || !read_string(tables_file, mesh_stamp))
+        {
+            return nullptr;
+        }
+        if (get_file_stamp(mesh_path) != mesh_stamp)
+        {
+            ROS_INFO("Mesh %s has changed, compiling the model...", mesh_path.c_str());
+            return nullptr;
+        }
+    }
+
+    std::map<std::string, std::vector<std::string>> joint_names;
+    std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> cached_mesh_paths;
+    std::map<int, std::vector<mjtNum>> geom_pose;
+    bool success = read_string(tables_file, tmp_model_xml) && read_string(tables_file, cache_model_xml);
+
+    uint64_t size = 0;
+    success = success && read_value(tables_file, size);
+    for (uint64_t i = 0; success && i < size; i++)
+    {
+        std::string robot;
+        uint64_t joint_num = 0;
+        success = read_string(tables_file, robot) && read_value(tables_file, joint_num);
+        for (uint64_t j = 0; success && j < joint_num; j++)
+        {
+            std::string joint_name;
+            success = read_string(tables_file, joint_name);
+            joint_names[robot].push_back(joint_name);
+        }
+    }
+
+    success = success && read_value(tables_file, size);
+    for (uint64_t i = 0; success && i < size; i++)
+    {
+        std::string mesh_name, mesh_path;
+        std::vector<mjtNum> scale;
+        success = read_string(tables_file, mesh_name) && read_string(tables_file, mesh_path) && read_nums(tables_file, scale);
+        cached_mesh_paths[mesh_name] = {mesh_path, scale};
+    }
+
+    success = success && read_value(tables_file, size);
+    for (uint64_t i = 0; success && i < size; i++)
+    {
+        int geom_id;
+        success = read_value(tables_file, geom_id) && read_nums(tables_file, geom_pose[geom_id]);
+    }
+
+    if (!success)
+    {
+        ROS_WARN("Model cache %s is truncated, compiling the model...", key.c_str());
+        return nullptr;
+    }
+
+    mjModel *cached_model = mj_loadModel(mjb_path.c_str(), nullptr);
+    if (cached_model == nullptr)
+    {
+        ROS_WARN("Failed to load model cache %s, compiling the model...", mjb_path.c_str());
+        return nullptr;
+    }
+
+    MjSim::joint_names = joint_names;
+    mesh_paths = cached_mesh_paths;
+    MjSim::geom_pose = geom_pose;
+
+    ROS_INFO("Loaded model from cache %s", mjb_path.c_str());
+    return cached_model;
+}
+
+void MjModelCache::save(const std::string &tmp_model_xml, const std::string &cache_model_xml)
+{
+    if (!enabled || m == nullptr)
+    {
+        return;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(cache_path, ec);
+
+    // Write to temporary files first, another instance may be loading the same key
+    const boost::filesystem::path mjb_path = cache_path / (key + ".mjb");
+    const boost::filesystem::path tables_path = cache_path / (key + ".tables");
+    const boost::filesystem::path mjb_tmp_path = cache_path / (key + "_" + tmp_model_name + ".mjb");
+    const boost::filesystem::path tables_tmp_path = cache_path / (key + "_" + tmp_model_name + ".tables");
+
+    mj_saveModel(m, mjb_tmp_path.c_str(), nullptr, 0);
+
+    std::ofstream tables_file(tables_tmp_path.string(), std::ios::binary);
+    write_string(tables_file, cache_magic);
+
+    write_value(tables_file, static_cast<uint64_t>(mesh_paths.size()));
+    for (const std::pair<const std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> &mesh_path : mesh_paths)
+    {
+        write_string(tables_file, mesh_path.second.first.string());
+        write_string(tables_file, get_file_stamp(mesh_path.second.first));
+    }
+
+    write_string(tables_file, tmp_model_xml);
+    write_string(tables_file, cache_model_xml);
+
+    write_value(tables_file, static_cast<uint64_t>(MjSim::joint_names.size()));
+    for (const std::pair<const std::string, std::vector<std::string>> &robot_joint_names : MjSim::joint_names)
+    {
+        write_string(tables_file, robot_joint_names.first);
+        write_value(tables_file, static_cast<uint64_t>(robot_joint_names.second.size()));
+        for (const std::string &joint_name : robot_joint_names.second)
+        {
+            write_string(tables_file, joint_name);
+        }
+    }
+
+    write_value(tables_file, static_cast<uint64_t>(mesh_paths.size()));
+    for (const std::pair<const std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>> &mesh_path : mesh_paths)
+    {
+        write_string(tables_file, mesh_path.first);
+        write_string(tables_file, mesh_path.second.first.string());
+        write_nums(tables_file, mesh_path.second.second);
+    }
+
+    mtx.lock();
+    write_value(tables_file, static_cast<uint64_t>(MjSim::geom_pose.size()));
+    for (const std::pair<const int, std::vector<mjtNum>> &geom_pose : MjSim::geom_pose)
+    {
+        write_value(tables_file, geom_pose.first);
+        write_nums(tables_file, geom_pose.second);
+    }
+    mtx.unlock();
+
+    tables_file.close();
+    if (!tables_file || !boost::filesystem::exists(mjb_tmp_path))
+    {
+        ROS_WARN("Failed to save model cache %s", key.c_str());
+        boost::filesystem::remove(mjb_tmp_path, ec);
+        boost::filesystem::remove(tables_tmp_path, ec);
+        return;
+    }
+
+    boost::filesystem::rename(mjb_tmp_path, mjb_path, ec);
+    boost::filesystem::rename(tables_tmp_path, tables_path, ec);
+    ROS_INFO("Saved model cache %s", mjb_path.c_str());
+}
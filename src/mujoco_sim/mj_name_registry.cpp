@@ -0,0 +1,119 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "mj_name_registry.h"
+
+#include <vector>
+
+static const std::vector<std::pair<mjtObj, int mjModel::*>> object_nums = {
+    {mjtObj::mjOBJ_BODY, &mjModel::nbody},
+    {mjtObj::mjOBJ_JOINT, &mjModel::njnt},
+    {mjtObj::mjOBJ_GEOM, &mjModel::ngeom},
+    {mjtObj::mjOBJ_SITE, &mjModel::nsite},
+    {mjtObj::mjOBJ_MESH, &mjModel::nmesh},
+    {mjtObj::mjOBJ_MATERIAL, &mjModel::nmat},
+    {mjtObj::mjOBJ_TENDON, &mjModel::ntendon},
+    {mjtObj::mjOBJ_ACTUATOR, &mjModel::nu},
+    {mjtObj::mjOBJ_SENSOR, &mjModel::nsensor}};
+
+void MjNameRegistry::bind(const mjModel *model)
+{
+    Names *new_names = new Names();
+    new_names->model = model;
+    for (const std::pair<mjtObj, int mjModel::*> &object_num : object_nums)
+    {
+        std::unordered_map<std::string, int> &ids = new_names->ids[object_num.first];
+        ids.reserve(model->*object_num.second);
+        for (int id = 0; id < model->*object_num.second; id++)
+        {
+            const char *name = mj_id2name(model, object_num.first, id);
+            if (name != nullptr)
+            {
+                ids.emplace(name, id);
+            }
+        }
+    }
+
+    Names *old_names = names.exchange(new_names, std::memory_order_acq_rel);
+    if (old_names != nullptr)
+    {
+        retire([old_names]()
+               { delete old_names; });
+    }
+
+    std::lock_guard<std::mutex> lk(reserve_mtx);
+    reserved_names.clear();
+}
+
+int MjNameRegistry::get_id(const mjtObj type, const std::string &name, const mjModel *model) const
+{
+    const Names *current_names = names.load(std::memory_order_acquire);
+    if (current_names == nullptr || current_names->model != model)
+    {
+        return mj_name2id(model, type, name.c_str());
+    }
+
+    std::map<mjtObj, std::unordered_map<std::string, int>>::const_iterator ids_it = current_names->ids.find(type);
+    if (ids_it == current_names->ids.end())
+    {
+        return mj_name2id(model, type, name.c_str());
+    }
+
+    std::unordered_map<std::string, int>::const_iterator id_it = ids_it->second.find(name);
+    return id_it != ids_it->second.end() ? id_it->second : -1;
+}
+
+bool MjNameRegistry::is_taken(const mjtObj type, const std::string &name) const
+{
+    std::map<mjtObj, std::unordered_set<std::string>>::const_iterator reserved_names_it = reserved_names.find(type);
+    return get_id(type, name) != -1 || (reserved_names_it != reserved_names.end() && reserved_names_it->second.count(name) != 0);
+}
+
+std::string MjNameRegistry::make_unique_name(const mjtObj type, const std::string &name)
+{
+    MjModelReader reader;
+    std::lock_guard<std::mutex> lk(reserve_mtx);
+    if (!is_taken(type, name))
+    {
+        reserved_names[type].insert(name);
+        return name;
+    }
+
+    // Strip a trailing "_<number>", every name with the same prefix shares one counter
+    std::string prefix = name;
+    const size_t last_underscore_index = name.find_last_of("_");
+    if (last_underscore_index != std::string::npos &&
+        last_underscore_index + 1 < name.size() &&
+        name.find_first_not_of("0123456789", last_underscore_index + 1) == std::string::npos)
+    {
+        prefix = name.substr(0, last_underscore_index);
+    }
+
+    int &counter = prefix_counters[type][prefix];
+    std::string unique_name;
+    do
+    {
+        unique_name = prefix + "_" + std::to_string(counter++);
+    } while (is_taken(type, unique_name));
+
+    reserved_names[type].insert(unique_name);
+    return unique_name;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mj_pacer.h"
+
+#include <cerrno>
+
+// Sleeping is woken up late by the scheduler, the last part is spun
+static constexpr double spin_time = 2E-4;
+
+static double to_sec(const timespec &time)
+{
+    return time.tv_sec + time.tv_nsec * 1E-9;
+}
+
+static timespec to_timespec(const double time)
+{
+    timespec result;
+    result.tv_sec = static_cast<time_t>(time);
+    result.tv_nsec = static_cast<long>((time - result.tv_sec) * 1E9);
+    if (result.tv_nsec >= 1000000000L)
+    {
+        result.tv_sec++;
+        result.tv_nsec -= 1000000000L;
+    }
+    return result;
+}
+
+MjPacer::MjPacer(const double real_time_factor, const size_t window_size) : real_time_factor(real_time_factor), samples(window_size > 1 ? window_size : 2)
+{
+}
+
+void MjPacer::restart(const double sim_time, const timespec &now)
+{
+    wall_start = now;
+    sim_start = sim_time;
+    sample_num = 0;
+    started = true;
+}
+
+double MjPacer::wait(const double sim_time)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!started || sim_time < last_sim_time)
+    {
+        restart(sim_time, now);
+    }
+    last_sim_time = sim_time;
+
+    double error_time = 0.0;
+    if (real_time_factor > 0.0)
+    {
+        const double deadline = to_sec(wall_start) + (sim_time - sim_start) / real_time_factor;
+        if (deadline - to_sec(now) > spin_time)
+        {
+            const timespec sleep_deadline = to_timespec(deadline - spin_time);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleep_deadline, nullptr) == EINTR)
+            {
+                // Interrupted by a signal, sleep again until the deadline
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        }
+        while (to_sec(now) < deadline)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        }
+        error_time = to_sec(now) - deadline;
+    }
+
+    // Average the real time factor over the samples in the window
+    const size_t sample_tail = (sample_head + samples.size() - sample_num) % samples.size();
+    if (sample_num == samples.size())
+    {
+        const double wall_time_diff = to_sec(now) - samples[sample_tail].first;
+        const double sim_time_diff = sim_time - samples[sample_tail].second;
+        rtf = wall_time_diff > 0.0 ? sim_time_diff / wall_time_diff : 0.0;
+    }
+    else
+    {
+        sample_num++;
+    }
+    samples[sample_head] = std::make_pair(to_sec(now), sim_time);
+    sample_head = (sample_head + 1) % samples.size();
+
+    return error_time;
+}
+
+double MjPacer::get_rtf() const
+{
+    return rtf;
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mj_publish_scheduler.h"
+
+#include <ros/ros.h>
+#include <thread>
+
+// Waits are cut at this time to notice the shutdown of ros
+static const std::chrono::milliseconds shutdown_poll_period(100);
+
+bool MjPublishScheduler::add_job(const double rate, std::function<void()> job)
+{
+    if (rate < 1E-9)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lk(mtx);
+    if (running)
+    {
+        ROS_ERROR("Failed to add a publisher job, the publish scheduler is already running");
+        return false;
+    }
+    jobs.push_back({std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate)), job});
+    deadlines.push({std::chrono::steady_clock::now(), jobs.size() - 1});
+    cv.notify_one();
+    return true;
+}
+
+void MjPublishScheduler::run(const int thread_num)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        running = true;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < thread_num; i++)
+    {
+        threads.emplace_back(&MjPublishScheduler::work, this);
+    }
+    work();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void MjPublishScheduler::work()
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    while (ros::ok())
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (deadlines.empty() || deadlines.top().time > now)
+        {
+            const std::chrono::steady_clock::time_point wake_time = now + shutdown_poll_period;
+            cv.wait_until(lk, deadlines.empty() ? wake_time : std::min(deadlines.top().time, wake_time));
+            continue;
+        }
+
+        // The job is out of the heap while it runs, so no other thread can take it.
+        // jobs doesn't change while running, so the reference stays valid without mtx
+        const Deadline deadline = deadlines.top();
+        deadlines.pop();
+        Job &job = jobs[deadline.job_id];
+        lk.unlock();
+
+        job.function();
+
+        lk.lock();
+        // Missed cycles are dropped instead of being run back to back, like ros::Rate does
+        std::chrono::steady_clock::time_point next_time = deadline.time + job.period;
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (next_time < end - job.period)
+        {
+            next_time = end;
+        }
+        deadlines.push({next_time, deadline.job_id});
+        cv.notify_one();
+    }
+}
@@ -19,6 +19,10 @@
 // SOFTWARE.
 
 #include "mj_ros.h"
+#include "mj_message_pool.h"
+#include "mj_name_registry.h"
+#include "mj_snapshot.h"
+#include "mj_spawn_pool.h"
 
 #include "mj_util.h"
 
@@ -26,8 +30,12 @@
 #include <controller_manager_msgs/ControllerState.h>
 #include <controller_manager_msgs/ListControllers.h>
 #include <controller_manager_msgs/SwitchController.h>
+#include <deque>
+#include <memory>
 #include <numeric>
 #include <ros/package.h>
+#include <rosgraph_msgs/Clock.h>
+#include <sys/stat.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <thread>
 #include <urdf/model.h>
@@ -45,37 +53,194 @@ static std::map<EObjectType, double> pub_joint_states_rate;
 
 static double pub_base_pose_rate;
 static double pub_sensor_data_rate;
+static double pub_sensor_data_array_rate;
+static double pub_sim_stats_rate;
+
+// Number of threads running the publishers
+static int publisher_thread_num;
 static double spawn_and_destroy_objects_rate;
 static int spawn_object_count_per_cycle;
 
 static std::map<EObjectType, visualization_msgs::Marker> marker;
 static std::map<EObjectType, visualization_msgs::MarkerArray> marker_array;
-static std::map<EObjectType, sensor_msgs::JointState> joint_states;
-static std::map<EObjectType, mujoco_msgs::ObjectStateArray> object_state_array;
+// Messages being filled by the publisher threads, taken from their message pools
+static std::map<EObjectType, boost::shared_ptr<sensor_msgs::JointState>> joint_states;
+static std::map<EObjectType, boost::shared_ptr<mujoco_msgs::ObjectStateArray>> object_state_array;
+
+// Number of entries filled in the current message, the entries after it are left from earlier cycles
+static std::map<EObjectType, size_t> joint_state_nums;
+static std::map<EObjectType, size_t> object_state_nums;
 static std::map<EObjectType, bool> free_bodies_only;
 
 static std::map<std::string, nav_msgs::Odometry> base_poses;
 
-static std::condition_variable condition;
+// State of the last step, copied by every publisher thread
+static thread_local MjSnapshot snapshot;
 
 static int spawn_nr = 0;
-static std::mutex spawn_mtx;
-static std::vector<mujoco_msgs::ObjectStatus> objects_to_spawn;
 static std::set<std::string> spawned_object_names;
-static bool spawn_success;
+
+// Object infos of the compiled objects, soft destroy parks their bodies in the pool
+static std::map<std::string, mujoco_msgs::ObjectInfo> spawned_object_infos;
 
 static int destroy_nr = 0;
-static std::mutex destroy_mtx;
-static std::set<std::string> object_names_to_destroy;
-static bool destroy_success;
+
+/**
+ * @brief A spawn or destroy service call waiting for the next model edit
+ *
+ */
+struct EditRequest
+{
+    // Number of the spawn or destroy call, for logging
+    int nr = 0;
+
+    // Ticket of the request in /mujoco/spawn_status
+    unsigned int ticket = 0;
+
+    // mujoco_sim::SpawnStatus::SPAWN, mujoco_sim::SpawnStatus::DESTROY or mujoco_sim::SpawnStatus::COMPACT
+    unsigned char type = mujoco_sim::SpawnStatus::SPAWN;
+
+    std::vector<mujoco_msgs::ObjectStatus> objects_to_spawn;
+
+    std::set<std::string> object_names_to_destroy;
+
+    // Objects which didn't fit into the pool and bodies which weren't in the pool, they need a recompile
+    std::vector<mujoco_msgs::ObjectStatus> objects_to_compile;
+
+    std::set<std::string> body_names_to_remove;
+
+    std::chrono::steady_clock::time_point received;
+
+    // Time spent in the queue and in the edit, in ms
+    double queue_time = 0.0;
+    double edit_time = 0.0;
+
+    // Number of requests applied in the same edit
+    size_t batch_size = 0;
+
+    bool done = false;
+
+    bool success = false;
+};
+
+static std::mutex edit_mtx;
+// Wakes up the spawn and destroy thread
+static std::condition_variable edit_condition;
+// Wakes up the waiting service calls
+static std::condition_variable edit_done_condition;
+static std::deque<std::shared_ptr<EditRequest>> edit_requests;
+static unsigned int edit_ticket = 0;
+
+// Requests arriving within this window after the first one are applied in the same model edit
+static double spawn_coalesce_window;
+
+// Time a blocking spawn or destroy call waits for its edit
+static double spawn_timeout;
+
+// Destroyed objects are parked in the spawn pool instead of being removed by a recompile
+static bool soft_destroy;
+
+// Parked bodies are removed once they make up this fraction of the bodies
+static double compact_ratio;
 
 static bool pub_tf_of_free_bodies_only;
 static bool pub_object_marker_array_of_free_bodies_only;
 static bool pub_object_state_array_of_free_bodies_only;
 
+static bool pub_tf_of_moved_bodies_only;
+static bool pub_object_marker_array_of_moved_bodies_only;
+static bool pub_object_state_array_of_moved_bodies_only;
+
+// A body has moved if its translation or rotation changed by more than these tolerances since it was last published
+static double motion_translation_tolerance;
+static double motion_rotation_tolerance;
+
+// Bodies that have not moved are published again after this interval (in seconds, <= 0 <=> never)
+static double motion_keep_alive_interval;
+
 static std::map<mjtObj, std::map<std::string, std::string>> name_map;
 
-static std::map<mjtObj, int> unique_index = {{mjtObj::mjOBJ_MESH, 0}, {mjtObj::mjOBJ_BODY, 0}, {mjtObj::mjOBJ_JOINT, 0}, {mjtObj::mjOBJ_GEOM, 0}};
+// Meshes of spawned objects by file, spawning the same file again reuses the mesh
+static std::map<std::string, std::string> mesh_names_of_files;
+
+/**
+ * @brief A parsed MJCF file of spawnable objects
+ *
+ */
+struct MjcfTemplate
+{
+    // Size and modification time in ns of the parsed file
+    off_t size = 0;
+    timespec mtime = {0, 0};
+
+    // Relative mesh files are resolved to absolute paths
+    tinyxml2::XMLDocument doc;
+};
+
+// Templates by path, only used by the spawn and destroy thread
+static std::map<std::string, std::unique_ptr<MjcfTemplate>> mjcf_templates;
+
+/**
+ * @brief Get the parsed MJCF file, the file is parsed again only after it was modified
+ *
+ * @param path Absolute path of the MJCF file
+ * @return const tinyxml2::XMLDocument* nullptr if the file can't be loaded
+ */
+static const tinyxml2::XMLDocument *get_mjcf_template(const boost::filesystem::path &path)
+{
+    // Scripts may rewrite a file within a second, so the modification time is compared in ns
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<MjcfTemplate> &mjcf_template = mjcf_templates[path.string()];
+    if (mjcf_template != nullptr &&
+        mjcf_template->size == file_stat.st_size &&
+        mjcf_template->mtime.tv_sec == file_stat.st_mtim.tv_sec &&
+        mjcf_template->mtime.tv_nsec == file_stat.st_mtim.tv_nsec)
+    {
+        return &mjcf_template->doc;
+    }
+
+    mjcf_template.reset(new MjcfTemplate());
+    if (!load_XML(mjcf_template->doc, path.c_str()) || mjcf_template->doc.FirstChild() == nullptr)
+    {
+        mjcf_templates.erase(path.string());
+        return nullptr;
+    }
+    mjcf_template->size = file_stat.st_size;
+    mjcf_template->mtime = file_stat.st_mtim;
+
+    // Resolve the mesh files once, the meshdir of a compiler applies to the assets after it
+    boost::filesystem::path mesh_dir = path.parent_path();
+    for (tinyxml2::XMLNode *node = mjcf_template->doc.FirstChild()->FirstChild();
+         node != nullptr;
+         node = node->NextSibling())
+    {
+        if (node->ToElement() == nullptr)
+        {
+            continue;
+        }
+
+        if (strcmp(node->Value(), "compiler") == 0 && node->ToElement()->Attribute("meshdir") != nullptr)
+        {
+            mesh_dir = mesh_dir / node->ToElement()->Attribute("meshdir");
+        }
+        else if (strcmp(node->Value(), "asset") == 0)
+        {
+            do_each_child_element(node->ToElement(), "mesh", [&](tinyxml2::XMLElement *mesh_element)
+                                  {
+                                    if (mesh_element->Attribute("file") != nullptr && mesh_element->Attribute("file")[0] != '/')
+                                    {
+                                        mesh_element->SetAttribute("file", (mesh_dir / mesh_element->Attribute("file")).c_str());
+                                    } });
+        }
+    }
+
+    return &mjcf_template->doc;
+}
 
 static bool init_urdf(urdf::Model &urdf_model, const ros::NodeHandle &n, const char *robot_description = "robot_description")
 {
@@ -91,98 +256,422 @@ static bool init_urdf(urdf::Model &urdf_model, const ros::NodeHandle &n, const c
     }
 }
 
-static void set_ros_msg(MjRos &mj_ros, const EObjectType object_type, bool free_body_only, std::function<void(MjRos &, const int, const EObjectType)> function)
+/**
+ * @brief Get the body id of an object, objects spawned from the pool are resolved to their slot bodies
+ * and parked bodies of destroyed objects are not found
+ *
+ */
+static int get_body_id(const std::string &object_name)
+{
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+    const int body_id = mj_spawn_pool.get_body_id(object_name);
+    if (body_id != -1)
+    {
+        return body_id;
+    }
+
+    const int named_body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, object_name);
+    return named_body_id != -1 && mj_spawn_pool.is_free_slot(named_body_id) ? -1 : named_body_id;
+}
+
+/**
+ * @brief Get the object name of a body, slot bodies of the pool are resolved to their claiming objects
+ *
+ */
+static std::string get_body_name(const mjModel *model, const int body_id)
+{
+    std::string object_name;
+    return MjSpawnPool::get_instance().get_object_name(body_id, object_name) ? object_name : mj_id2name(model, mjtObj::mjOBJ_BODY, body_id);
+}
+
+/**
+ * @brief Bodies of every object type, built once per model and per change of the spawned objects
+ *
+ */
+struct BodyIndex
 {
+    unsigned int model_version;
 
-    for (int body_id = 1; body_id < m->nbody; body_id++)
+    unsigned int spawned_version;
+
+    std::map<EObjectType, std::vector<int>> body_ids;
+
+    std::map<EObjectType, std::vector<int>> free_body_ids;
+
+    // Names of the indexed bodies by body id, the object names for bodies of the spawn pool
+    std::vector<std::string> body_names;
+};
+
+static std::atomic<BodyIndex *> body_index(nullptr);
+
+static std::mutex body_index_mtx;
+
+// Incremented whenever the spawned objects change
+static std::atomic<unsigned int> spawned_version(0);
+
+static bool is_free_body(const mjModel *model, const int body_id)
+{
+    return model->body_jntnum[body_id] == 1 && model->jnt_type[model->body_jntadr[body_id]] == mjJNT_FREE;
+}
+
+/**
+ * @brief Get the body index of the model of the snapshot, rebuild it if it's outdated. The caller must hold a MjModelReader
+ *
+ * @param current_snapshot Snapshot the body ids are used with
+ * @return const BodyIndex* The body index, nullptr if the model of the snapshot has already been replaced
+ */
+static const BodyIndex *get_body_index(const MjSnapshot &current_snapshot)
+{
+    BodyIndex *current_body_index = body_index.load(std::memory_order_acquire);
+    if (current_body_index != nullptr && current_body_index->model_version == current_snapshot.model_version && current_body_index->spawned_version == spawned_version)
     {
-        const std::string body_name = mj_id2name(m, mjtObj::mjOBJ_BODY, body_id);
-        switch (object_type)
+        return current_body_index;
+    }
+
+    // The spawn pool is only bound to the current model
+    if (current_snapshot.model_version != model_version)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(body_index_mtx);
+    current_body_index = body_index.load(std::memory_order_acquire);
+    if (current_body_index != nullptr && current_body_index->model_version == current_snapshot.model_version && current_body_index->spawned_version == spawned_version)
+    {
+        return current_body_index;
+    }
+
+    const mjModel *model = current_snapshot.model;
+    BodyIndex *new_body_index = new BodyIndex();
+    new_body_index->model_version = current_snapshot.model_version;
+    new_body_index->spawned_version = spawned_version;
+    new_body_index->body_names.resize(model->nbody);
+
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+    for (int body_id = 1; body_id < model->nbody; body_id++)
+    {
+        if (mj_spawn_pool.is_free_slot(body_id))
         {
-        case EObjectType::Robot:
-            if (MjSim::robot_link_names.find(body_name) != MjSim::robot_link_names.end())
-            {
-                function(mj_ros, body_id, object_type);
-            }
+            continue;
+        }
+
+        const std::string body_name = mj_id2name(model, mjtObj::mjOBJ_BODY, body_id);
+        new_body_index->body_names[body_id] = get_body_name(model, body_id);
+        EObjectType object_type;
+        if (MjSim::robot_link_names.find(body_name) != MjSim::robot_link_names.end())
+        {
+            // Robot bodies are published regardless of the free body filter
+            new_body_index->body_ids[EObjectType::Robot].push_back(body_id);
+            new_body_index->free_body_ids[EObjectType::Robot].push_back(body_id);
+            continue;
+        }
+        else if (MjSim::spawned_object_body_names.find(body_name) != MjSim::spawned_object_body_names.end())
+        {
+            object_type = EObjectType::SpawnedObject;
+        }
+        else if (MjSim::robot_names.find(body_name) == MjSim::robot_names.end())
+        {
+            object_type = EObjectType::World;
+        }
+        else
+        {
+            continue;
+        }
+
+        new_body_index->body_ids[object_type].push_back(body_id);
+        if (is_free_body(model, body_id))
+        {
+            new_body_index->free_body_ids[object_type].push_back(body_id);
+        }
+    }
+
+    if (current_snapshot.model_version != model_version)
+    {
+        // The model has been replaced while building, the pool may already be bound to the new one
+        delete new_body_index;
+        return nullptr;
+    }
+
+    body_index.store(new_body_index, std::memory_order_release);
+    if (current_body_index != nullptr)
+    {
+        retire([current_body_index]()
+               { delete current_body_index; });
+    }
+    return new_body_index;
+}
+
+/**
+ * @brief Fields of the marker of a geom that only change with the model
+ *
+ */
+struct MarkerTemplate
+{
+    // Type of visualization_msgs::Marker, -1 if the geom has no marker
+    int type = -1;
+
+    std::string mesh_resource;
+
+    geometry_msgs::Vector3 scale;
+
+    std_msgs::ColorRGBA color;
+
+    // Pose of a mesh in its body, meshes are placed relative to the body instead of the geom frame
+    bool is_mesh = false;
+    mjtNum geom_pos[3] = {0, 0, 0};
+    mjtNum geom_quat[4] = {1, 0, 0, 0};
+};
+
+/**
+ * @brief Marker templates of every geom, built once per model, per change of MjSim::geom_pose and per change of the spawned objects
+ *
+ */
+struct MarkerTemplates
+{
+    unsigned int model_version;
+
+    unsigned int geom_pose_version;
+
+    // Pool claims rewrite geom_size and geom_rgba of the slot geoms in place
+    unsigned int spawned_version;
+
+    std::vector<MarkerTemplate> geoms;
+};
+
+static std::atomic<MarkerTemplates *> marker_templates(nullptr);
+
+static std::mutex marker_templates_mtx;
+
+/**
+ * @brief Check if the marker templates match the model of the snapshot, the geom poses and the spawned objects
+ *
+ */
+static bool is_current(const MarkerTemplates *current_marker_templates, const MjSnapshot &current_snapshot)
+{
+    return current_marker_templates != nullptr &&
+           current_marker_templates->model_version == current_snapshot.model_version &&
+           current_marker_templates->geom_pose_version == MjSim::geom_pose_version &&
+           current_marker_templates->spawned_version == spawned_version;
+}
+
+/**
+ * @brief Get the marker templates of the model of the snapshot, rebuild them if they are outdated. The caller must hold a MjModelReader
+ *
+ * @param current_snapshot Snapshot the templates are used with
+ * @return const MarkerTemplates* The marker templates, nullptr if the model of the snapshot has already been replaced
+ */
+static const MarkerTemplates *get_marker_templates(const MjSnapshot &current_snapshot)
+{
+    MarkerTemplates *current_marker_templates = marker_templates.load(std::memory_order_acquire);
+    if (is_current(current_marker_templates, current_snapshot))
+    {
+        return current_marker_templates;
+    }
+
+    std::lock_guard<std::mutex> lk(marker_templates_mtx);
+    current_marker_templates = marker_templates.load(std::memory_order_acquire);
+    if (is_current(current_marker_templates, current_snapshot))
+    {
+        return current_marker_templates;
+    }
+
+    // geom_pose is rebuilt by the model thread after a model change, copy it with mtx locked
+    std::map<int, std::vector<mjtNum>> geom_pose;
+    mtx.lock();
+    if (current_snapshot.model_version != model_version)
+    {
+        mtx.unlock();
+        return nullptr;
+    }
+    const unsigned int geom_pose_version = MjSim::geom_pose_version;
+    const unsigned int current_spawned_version = spawned_version;
+    geom_pose = MjSim::geom_pose;
+    mtx.unlock();
+
+    const mjModel *model = current_snapshot.model;
+    MarkerTemplates *new_marker_templates = new MarkerTemplates();
+    new_marker_templates->model_version = current_snapshot.model_version;
+    new_marker_templates->geom_pose_version = geom_pose_version;
+    new_marker_templates->spawned_version = current_spawned_version;
+    new_marker_templates->geoms.resize(model->ngeom);
+
+    for (int geom_id = 0; geom_id < model->ngeom; geom_id++)
+    {
+        MarkerTemplate &marker_template = new_marker_templates->geoms[geom_id];
+        boost::filesystem::path mesh_path;
+        std::map<int, std::vector<mjtNum>>::const_iterator geom_pose_it;
+        switch (model->geom_type[geom_id])
+        {
+        case mjtGeom::mjGEOM_BOX:
+            marker_template.type = visualization_msgs::Marker::CUBE;
+            marker_template.scale.x = model->geom_size[3 * geom_id] * 2;
+            marker_template.scale.y = model->geom_size[3 * geom_id + 1] * 2;
+            marker_template.scale.z = model->geom_size[3 * geom_id + 2] * 2;
             break;
 
-        case EObjectType::World:
-            if (MjSim::robot_names.find(body_name) == MjSim::robot_names.end() && MjSim::robot_link_names.find(body_name) == MjSim::robot_link_names.end() && MjSim::spawned_object_body_names.find(body_name) == MjSim::spawned_object_body_names.end())
-            {
-                if (!free_body_only ||
-                    (m->body_jntnum[body_id] == 1 && m->jnt_type[m->body_jntadr[body_id]] == mjJNT_FREE))
-                {
-                    function(mj_ros, body_id, object_type);
-                }
-            }
+        case mjtGeom::mjGEOM_SPHERE:
+            marker_template.type = visualization_msgs::Marker::SPHERE;
+            marker_template.scale.x = model->geom_size[3 * geom_id] * 2;
+            marker_template.scale.y = model->geom_size[3 * geom_id] * 2;
+            marker_template.scale.z = model->geom_size[3 * geom_id] * 2;
             break;
 
-        case EObjectType::SpawnedObject:
-            if (MjSim::spawned_object_body_names.find(body_name) != MjSim::spawned_object_body_names.end())
+        case mjtGeom::mjGEOM_CYLINDER:
+            marker_template.type = visualization_msgs::Marker::CYLINDER;
+            marker_template.scale.x = model->geom_size[3 * geom_id] * 2;
+            marker_template.scale.y = model->geom_size[3 * geom_id] * 2;
+            marker_template.scale.z = model->geom_size[3 * geom_id + 1] * 2;
+            break;
+
+        case mjtGeom::mjGEOM_MESH:
+            mesh_path = boost::filesystem::relative(mesh_paths[mj_id2name(model, mjtObj::mjOBJ_MESH, model->geom_dataid[geom_id])].first, tmp_world_path.parent_path());
+            if (!boost::filesystem::exists(tmp_world_path.parent_path() / mesh_path) || !mesh_path.has_extension())
             {
-                if (!free_body_only ||
-                    (m->body_jntnum[body_id] == 1 && m->jnt_type[m->body_jntadr[body_id]] == mjJNT_FREE))
-                {
-                    function(mj_ros, body_id, object_type);
-                }
+                ROS_WARN("Body %s: Mesh %s - %s not found in [%s]", mj_id2name(model, mjtObj::mjOBJ_BODY, model->geom_bodyid[geom_id]), mj_id2name(model, mjtObj::mjOBJ_MESH, model->geom_dataid[geom_id]), mesh_paths[std::string(mj_id2name(model, mjtObj::mjOBJ_MESH, model->geom_dataid[geom_id]))].first.c_str(), mesh_path.parent_path().c_str());
+                continue;
+            }
+            marker_template.type = visualization_msgs::Marker::MESH_RESOURCE;
+            marker_template.mesh_resource = "package://mujoco_sim/model/tmp/" + mesh_path.string();
+            marker_template.scale.x = 1;
+            marker_template.scale.y = 1;
+            marker_template.scale.z = 1;
+
+            marker_template.is_mesh = true;
+            geom_pose_it = geom_pose.find(geom_id);
+            if (geom_pose_it != geom_pose.end())
+            {
+                mju_copy3(marker_template.geom_pos, geom_pose_it->second.data());
+                mju_copy4(marker_template.geom_quat, geom_pose_it->second.data() + 3);
             }
             break;
 
         default:
-            break;
+            continue;
         }
+
+        marker_template.color.a = model->geom_rgba[4 * geom_id + 3];
+        marker_template.color.r = model->geom_rgba[4 * geom_id];
+        marker_template.color.g = model->geom_rgba[4 * geom_id + 1];
+        marker_template.color.b = model->geom_rgba[4 * geom_id + 2];
     }
+
+    marker_templates.store(new_marker_templates, std::memory_order_release);
+    if (current_marker_templates != nullptr)
+    {
+        retire([current_marker_templates]()
+               { delete current_marker_templates; });
+    }
+    return new_marker_templates;
 }
 
-static std::function<void(tinyxml2::XMLElement *, const mjtObj)> add_index = [](tinyxml2::XMLElement *element, const mjtObj type)
+/**
+ * @brief Last published poses of the bodies of one publisher, used to skip the bodies that have not moved
+ *
+ */
+struct MotionFilter
 {
-    if (element->Attribute("name") == nullptr)
+    explicit MotionFilter(const bool in_enabled) : enabled(in_enabled)
     {
-        return;
     }
 
-    std::string name = element->Attribute("name");
-    name += "_" + std::to_string(unique_index[type]);
-    name_map[type][element->Attribute("name")] = name;
-    element->SetAttribute("name", name.c_str());
+    /**
+     * @brief Check if the body has moved since it was last published and remember its pose if so.
+     * The caller must hold a MjModelReader and the snapshot must be read
+     *
+     * @param body_id Id of the body
+     * @param time Current time in seconds
+     * @return true The body has to be published
+     */
+    bool has_moved(const int body_id, const double time)
+    {
+        if (!enabled)
+        {
+            return true;
+        }
+
+        // Body ids are only stable within one model
+        if (poses.empty() || poses_model_version != snapshot.model_version)
+        {
+            poses_model_version = snapshot.model_version;
+            poses.assign(7 * snapshot.model->nbody, 0.0);
+            times.assign(snapshot.model->nbody, -1.0);
+        }
+
+        const mjtNum *xpos = snapshot.xpos + 3 * body_id;
+        const mjtNum *xquat = snapshot.xquat + 4 * body_id;
+        mjtNum *pose = poses.data() + 7 * body_id;
+        if (times[body_id] >= 0.0 && (motion_keep_alive_interval <= 0.0 || time - times[body_id] < motion_keep_alive_interval))
+        {
+            const mjtNum dx = xpos[0] - pose[0];
+            const mjtNum dy = xpos[1] - pose[1];
+            const mjtNum dz = xpos[2] - pose[2];
+            // The rotation angle between two unit quaternions is 2 acos(|q1 . q2|)
+            const mjtNum dot = mju_abs(xquat[0] * pose[3] + xquat[1] * pose[4] + xquat[2] * pose[5] + xquat[3] * pose[6]);
+            if (dx * dx + dy * dy + dz * dz <= motion_translation_tolerance * motion_translation_tolerance &&
+                dot >= mju_cos(motion_rotation_tolerance / 2.0))
+            {
+                return false;
+            }
+        }
+
+        mju_copy3(pose, xpos);
+        mju_copy4(pose + 3, xquat);
+        times[body_id] = time;
+        return true;
+    }
+
+    const bool enabled;
+
+    unsigned int poses_model_version = 0;
+
+    // Position and quaternion of every body when it was last published
+    std::vector<mjtNum> poses;
+
+    // Time every body was last published, < 0 if it never was
+    std::vector<double> times;
 };
 
-static std::function<void(tinyxml2::XMLElement *, const mjtObj)> check_index = [](tinyxml2::XMLElement *element, const mjtObj type)
+static void set_ros_msg(MjRos &mj_ros, const EObjectType object_type, bool free_body_only, std::function<void(MjRos &, const int, const EObjectType)> function, MotionFilter *motion_filter = nullptr)
 {
-    if (element->Attribute("name") == nullptr)
+    MjModelReader reader;
+    if (!MjSnapshotBuffer::get_instance().read(snapshot))
     {
         return;
     }
 
-    std::string name = element->Attribute("name");
+    const BodyIndex *current_body_index = get_body_index(snapshot);
+    if (current_body_index == nullptr)
+    {
+        return;
+    }
 
-    if (type != mjtObj::mjOBJ_MESH)
+    const std::map<EObjectType, std::vector<int>> &body_ids = free_body_only ? current_body_index->free_body_ids : current_body_index->body_ids;
+    std::map<EObjectType, std::vector<int>>::const_iterator body_ids_it = body_ids.find(object_type);
+    if (body_ids_it == body_ids.end())
     {
-        name_map[type].erase(name);
+        return;
     }
 
-    do
+    const double time = ros::Time::now().toSec();
+    for (const int body_id : body_ids_it->second)
     {
-        const size_t last_underscore_index = name.find_last_of("_");
-        const std::string string_after_underscore = name.substr(last_underscore_index + 1);
-        if (string_after_underscore.empty() || string_after_underscore.find_first_not_of("0123456789") != std::string::npos)
-        {
-            name += "_" + std::to_string(unique_index[type]);
-        }
-        else
+        if (motion_filter != nullptr && !motion_filter->has_moved(body_id, time))
         {
-            const size_t last_index = name.find_last_not_of("0123456789");
-            name.replace(last_index + 1, unique_index[type] / 10 + 1, std::to_string(unique_index[type]));
+            continue;
         }
+        function(mj_ros, body_id, object_type);
+    }
+}
 
-        if (mj_name2id(m, type, name.c_str()) != -1)
-        {
-            unique_index[type] += 1;
-        }
-    } while (mj_name2id(m, type, name.c_str()) != -1);
+static std::function<void(tinyxml2::XMLElement *, const mjtObj)> make_unique_name = [](tinyxml2::XMLElement *element, const mjtObj type)
+{
+    if (element->Attribute("name") == nullptr)
+    {
+        return;
+    }
 
+    const std::string name = MjNameRegistry::get_instance().make_unique_name(type, element->Attribute("name"));
     name_map[type][element->Attribute("name")] = name;
-
     element->SetAttribute("name", name.c_str());
 };
 
@@ -192,12 +681,16 @@ CmdVelCallback::CmdVelCallback(const std::string &in_robot) : robot(in_robot)
 
 void CmdVelCallback::callback(const geometry_msgs::Twist &msg)
 {
-    MjSim::odom_vels[robot + "_lin_odom_x_joint"] = MjSim::add_odom_joints[robot]["lin_odom_x_joint"] ? msg.linear.x : 0.0;
-    MjSim::odom_vels[robot + "_lin_odom_y_joint"] = MjSim::add_odom_joints[robot]["lin_odom_y_joint"] ? msg.linear.y : 0.0;
-    MjSim::odom_vels[robot + "_lin_odom_z_joint"] = MjSim::add_odom_joints[robot]["lin_odom_z_joint"] ? msg.linear.z : 0.0;
-    MjSim::odom_vels[robot + "_ang_odom_x_joint"] = MjSim::add_odom_joints[robot]["ang_odom_x_joint"] ? msg.angular.x : 0.0;
-    MjSim::odom_vels[robot + "_ang_odom_y_joint"] = MjSim::add_odom_joints[robot]["ang_odom_y_joint"] ? msg.angular.y : 0.0;
-    MjSim::odom_vels[robot + "_ang_odom_z_joint"] = MjSim::add_odom_joints[robot]["ang_odom_z_joint"] ? msg.angular.z : 0.0;
+    std::map<std::string, MjOdomPlan>::iterator odom_plan_it = MjSim::odom_plans.find(robot);
+    if (odom_plan_it != MjSim::odom_plans.end())
+    {
+        MjOdomPlan &odom_plan = odom_plan_it->second;
+        const mjtNum cmd_vels[6] = {msg.linear.x, msg.linear.y, msg.linear.z, msg.angular.x, msg.angular.y, msg.angular.z};
+        for (int i = 0; i < 6; i++)
+        {
+            odom_plan.cmd_vels[i].store((odom_plan.enabled & (1u << i)) ? cmd_vels[i] : 0.0, std::memory_order_relaxed);
+        }
+    }
 
     if (pub_base_pose_rate > 1E-9)
     {
@@ -227,6 +720,29 @@ void MjRos::set_params()
         }
     }
 
+    std::string mesh_staging;
+    if (ros::param::get("~mesh_staging", mesh_staging))
+    {
+        if (mesh_staging == "copy")
+        {
+            MjSim::mesh_staging = EMeshStaging::Copy;
+        }
+        else if (mesh_staging == "hardlink")
+        {
+            MjSim::mesh_staging = EMeshStaging::Hardlink;
+        }
+        else if (mesh_staging == "symlink")
+        {
+            MjSim::mesh_staging = EMeshStaging::Symlink;
+        }
+        else
+        {
+            ROS_WARN("Unknown mesh_staging [%s], use [copy] instead", mesh_staging.c_str());
+            mesh_staging = "copy";
+        }
+        ROS_INFO("Set mesh_staging to %s", mesh_staging.c_str());
+    }
+
     if (!ros::param::get("~disable_gravity", MjSim::disable_gravity))
     {
         MjSim::disable_gravity = true;
@@ -242,6 +758,57 @@ void MjRos::set_params()
         MjSim::max_time_step = 0.005;
     }
 
+    std::string run_mode;
+    if (ros::param::get("~run_mode", run_mode))
+    {
+        if (run_mode == "realtime")
+        {
+            MjSim::run_mode = ERunMode::RealTime;
+        }
+        else if (run_mode == "free")
+        {
+            MjSim::run_mode = ERunMode::FreeRun;
+        }
+        else if (run_mode == "lockstep")
+        {
+            MjSim::run_mode = ERunMode::LockStep;
+        }
+        else
+        {
+            ROS_WARN("Unknown run_mode [%s], use [realtime] instead", run_mode.c_str());
+            run_mode = "realtime";
+        }
+        ROS_INFO("Set run_mode to %s", run_mode.c_str());
+    }
+
+    if (ros::param::get("~real_time_factor", MjSim::real_time_factor))
+    {
+        ROS_INFO("Set real_time_factor = %f", MjSim::real_time_factor);
+    }
+
+    std::string effort_source;
+    if (ros::param::get("~effort_source", effort_source))
+    {
+        if (effort_source == "inverse")
+        {
+            MjSim::effort_source = EEffortSource::InverseDynamics;
+        }
+        else if (effort_source == "actuator")
+        {
+            MjSim::effort_source = EEffortSource::ActuatorForce;
+        }
+        else if (effort_source == "sensor")
+        {
+            MjSim::effort_source = EEffortSource::JointTorqueSensor;
+        }
+        else
+        {
+            ROS_WARN("Unknown effort_source [%s], use [inverse] instead", effort_source.c_str());
+            effort_source = "inverse";
+        }
+        ROS_INFO("Set effort_source to %s", effort_source.c_str());
+    }
+
     std::string world_path_string;
     if (ros::param::get("~world", world_path_string))
     {
@@ -261,16 +828,13 @@ void MjRos::set_params()
         else
         {
             ROS_WARN("Robot names not found in urdf, searching for robot names from mjcf...");
-            tinyxml2::XMLDocument cache_model_xml_doc;
-            if (!load_XML(cache_model_xml_doc, model_path.c_str()))
-            {
-                ROS_WARN("Failed to load file \"%s\"\n", model_path.c_str());
-            }
-            for (tinyxml2::XMLElement *worldbody_element = cache_model_xml_doc.FirstChildElement()->FirstChildElement("worldbody");
+            // The parsed model is reused by MjSim::init
+            const tinyxml2::XMLDocument *cache_model_xml_doc = MjSim::get_model_doc();
+            for (const tinyxml2::XMLElement *worldbody_element = cache_model_xml_doc != nullptr ? cache_model_xml_doc->FirstChildElement()->FirstChildElement("worldbody") : nullptr;
                  worldbody_element != nullptr;
                  worldbody_element = worldbody_element->NextSiblingElement("worldbody"))
             {
-                for (tinyxml2::XMLElement *body_element = worldbody_element->FirstChildElement();
+                for (const tinyxml2::XMLElement *body_element = worldbody_element->FirstChildElement();
                      body_element != nullptr;
                      body_element = body_element->NextSiblingElement())
                 {
@@ -383,6 +947,10 @@ void MjRos::init()
         {
             pub_object_marker_array_of_free_bodies_only = true;
         }
+        if (!ros::param::get("~pub_object_marker_array/moved_bodies_only", pub_object_marker_array_of_moved_bodies_only))
+        {
+            pub_object_marker_array_of_moved_bodies_only = false;
+        }
         if (!ros::param::get("~pub_object_marker_array/robot_bodies_rate", pub_marker_array_rate[EObjectType::Robot]))
         {
             pub_marker_array_rate[EObjectType::Robot] = 0.0;
@@ -403,6 +971,10 @@ void MjRos::init()
         {
             pub_tf_of_free_bodies_only = true;
         }
+        if (!ros::param::get("~pub_tf/moved_bodies_only", pub_tf_of_moved_bodies_only))
+        {
+            pub_tf_of_moved_bodies_only = false;
+        }
         if (!ros::param::get("~pub_tf/robot_bodies_rate", pub_tf_rate[EObjectType::Robot]))
         {
             pub_tf_rate[EObjectType::Robot] = 0.0;
@@ -423,6 +995,10 @@ void MjRos::init()
         {
             pub_object_state_array_of_free_bodies_only = true;
         }
+        if (!ros::param::get("~pub_object_state_array/moved_bodies_only", pub_object_state_array_of_moved_bodies_only))
+        {
+            pub_object_state_array_of_moved_bodies_only = false;
+        }
         if (!ros::param::get("~pub_object_state_array/robot_bodies_rate", pub_object_state_array_rate[EObjectType::Robot]))
         {
             pub_object_state_array_rate[EObjectType::Robot] = 0.0;
@@ -453,6 +1029,19 @@ void MjRos::init()
         }
     }
 
+    if (!ros::param::get("~motion_filter/translation_tolerance", motion_translation_tolerance))
+    {
+        motion_translation_tolerance = 1E-4;
+    }
+    if (!ros::param::get("~motion_filter/rotation_tolerance", motion_rotation_tolerance))
+    {
+        motion_rotation_tolerance = 1E-3;
+    }
+    if (!ros::param::get("~motion_filter/keep_alive_interval", motion_keep_alive_interval))
+    {
+        motion_keep_alive_interval = 1.0;
+    }
+
     if (!ros::param::get("~custom_controller_type", custom_controller_type)) {
         custom_controller_type = "";
     }
@@ -464,6 +1053,18 @@ void MjRos::init()
     {
         pub_sensor_data_rate = 60.0;
     }
+    if (!ros::param::get("~pub_sensor_data_array_rate", pub_sensor_data_array_rate))
+    {
+        pub_sensor_data_array_rate = pub_sensor_data_rate;
+    }
+    if (!ros::param::get("~pub_sim_stats_rate", pub_sim_stats_rate))
+    {
+        pub_sim_stats_rate = 10.0;
+    }
+    if (!ros::param::get("~publisher_threads", publisher_thread_num) || publisher_thread_num < 1)
+    {
+        publisher_thread_num = 1;
+    }
     if (!ros::param::get("~spawn_and_destroy_objects_rate", spawn_and_destroy_objects_rate))
     {
         spawn_and_destroy_objects_rate = 600.0;
@@ -476,6 +1077,22 @@ void MjRos::init()
     {
         spawn_object_count_per_cycle = -1;
     }
+    if (!ros::param::get("~spawn_coalesce_window", spawn_coalesce_window))
+    {
+        spawn_coalesce_window = 0.005;
+    }
+    if (!ros::param::get("~spawn_timeout", spawn_timeout))
+    {
+        spawn_timeout = 1.0;
+    }
+    if (!ros::param::get("~soft_destroy", soft_destroy))
+    {
+        soft_destroy = false;
+    }
+    if (!ros::param::get("~compact_ratio", compact_ratio))
+    {
+        compact_ratio = 0.25;
+    }
 
     ros_start = ros::Time::now();
 
@@ -485,7 +1102,7 @@ void MjRos::init()
     {
         for (const std::string joint_name : MjSim::joint_names[robot])
         {
-            joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
+            joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, joint_name);
             link_name = mj_id2name(m, mjtObj::mjOBJ_BODY, m->jnt_bodyid[joint_id]);
             MjSim::robot_link_names.insert(link_name);
         }
@@ -534,6 +1151,23 @@ void MjRos::init()
         }
     }
 
+    if (MjSim::run_mode != ERunMode::RealTime)
+    {
+        double clock_rate;
+        if (!ros::param::get("~clock_rate", clock_rate))
+        {
+            clock_rate = 1000.0;
+        }
+        clock_period = clock_rate > 1E-9 ? 1.0 / clock_rate : 0.0;
+        clock_pub = n.advertise<rosgraph_msgs::Clock>("/clock", 10);
+    }
+
+    if (MjSim::run_mode == ERunMode::LockStep)
+    {
+        step_sub = n.subscribe("/mujoco/step", 10, &MjRos::step_callback, this);
+        ROS_INFO("Waiting for steps on [%s].", step_sub.getTopic().c_str());
+    }
+
     screenshot_server = n.advertiseService("/mujoco/screenshot", &MjRos::screenshot_service, this);
     ROS_INFO("Started [%s] service.", screenshot_server.getService().c_str());
 
@@ -546,6 +1180,19 @@ void MjRos::init()
     destroy_objects_server = n.advertiseService("/mujoco/destroy_objects", &MjRos::destroy_objects_service, this);
     ROS_INFO("Started [%s] service.", destroy_objects_server.getService().c_str());
 
+    spawn_objects_async_server = n.advertiseService("/mujoco/spawn_objects_async", &MjRos::spawn_objects_async_service, this);
+    ROS_INFO("Started [%s] service.", spawn_objects_async_server.getService().c_str());
+
+    destroy_objects_async_server = n.advertiseService("/mujoco/destroy_objects_async", &MjRos::destroy_objects_async_service, this);
+    ROS_INFO("Started [%s] service.", destroy_objects_async_server.getService().c_str());
+
+    compact_server = n.advertiseService("/mujoco/compact", &MjRos::compact_service, this);
+    ROS_INFO("Started [%s] service.", compact_server.getService().c_str());
+
+    spawn_status_pub = n.advertise<mujoco_sim::SpawnStatus>("/mujoco/spawn_status", 100);
+
+    sim_stats_pub = n.advertise<mujoco_sim::SimStats>("/mujoco/sim_stats", 10);
+
     if (!ros::param::get("~joint_inits", joint_inits))
     {
         ROS_WARN("joint_inits not found, will set to default value (0)");
@@ -562,19 +1209,36 @@ void MjRos::init()
     joint_states_pub[EObjectType::World] = n.advertise<sensor_msgs::JointState>("/mujoco/world_joint_states", 0);
     joint_states_pub[EObjectType::SpawnedObject] = n.advertise<sensor_msgs::JointState>("/mujoco/object_joint_states", 0);
     sensors_pub = n.advertise<geometry_msgs::Vector3Stamped>("/mujoco/sensors_3D", 0);
+    sensor_data_array_pub = n.advertise<mujoco_sim::SensorDataArray>("/mujoco/sensor_data_array", 0);
+    sensor_names_pub = n.advertise<mujoco_sim::SensorNames>("/mujoco/sensor_names", 1, true);
 
     reset_robot();
+
+    // Export the initial state before the simulation thread starts stepping
+    mtx.lock();
+    MjSnapshotBuffer::get_instance().write();
+    mtx.unlock();
+
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+    mj_spawn_pool.init();
+    if (!mj_spawn_pool.empty())
+    {
+        // Compile the slots once, every later spawn of a fitting object only claims a slot
+        spawn_objects(mj_spawn_pool.get_slot_objects());
+    }
 }
 
 void MjRos::reset_robot()
 {
+    mjData *d_old = d;
     d = mj_makeData(m);
+    retire_model(nullptr, d_old);
     
     for (const std::string &robot : MjSim::robot_names)
     {
         for (const std::string &joint_name : MjSim::joint_names[robot])
         {
-            const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
+            const int joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, joint_name);
             if (joint_id != -1)
             {
                 const int qpos_id = m->jnt_qposadr[joint_id];
@@ -592,37 +1256,60 @@ void MjRos::reset_robot()
             }
         }
     }
-    for (std::pair<const std::string, mjtNum> &odom_joint : MjSim::odom_vels)
+    for (std::pair<const std::string, MjOdomPlan> &odom_plan : MjSim::odom_plans)
     {
-        odom_joint.second = 0.f;
-        const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, odom_joint.first.c_str());
-        if (joint_id != -1)
+        for (size_t i = 0; i < MjSim::odom_joint_names.size(); i++)
         {
-            const int qpos_id = m->jnt_qposadr[joint_id];
-            const int dof_id = m->jnt_dofadr[joint_id];
-            d->qpos[qpos_id] = 0.f;
-            d->qvel[dof_id] = 0.f;
-            d->qacc[dof_id] = 0.f;
+            odom_plan.second.cmd_vels[i] = 0.0;
+            const int joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, odom_plan.first + "_" + MjSim::odom_joint_names[i]);
+            if (joint_id != -1)
+            {
+                const int qpos_id = m->jnt_qposadr[joint_id];
+                const int dof_id = m->jnt_dofadr[joint_id];
+                d->qpos[qpos_id] = 0.f;
+                d->qvel[dof_id] = 0.f;
+                d->qacc[dof_id] = 0.f;
+            }
         }
     }
+    MjSpawnPool::get_instance().reset();
     mj_forward(m, d);
 }
 
 void MjRos::setup_publishers()
 {
-    std::thread ros_thread1(&MjRos::publish_tf, this, EObjectType::None);
-    std::thread ros_thread2(&MjRos::publish_marker_array, this, EObjectType::None);
-    std::thread ros_thread3(&MjRos::publish_object_state_array, this, EObjectType::None);
-    std::thread ros_thread4(&MjRos::publish_joint_states, this, EObjectType::None);
-    std::thread ros_thread5(&MjRos::publish_base_pose, this);
-    std::thread ros_thread6(&MjRos::publish_sensor_data, this);
-
-    ros_thread1.join();
-    ros_thread2.join();
-    ros_thread3.join();
-    ros_thread4.join();
-    ros_thread5.join();
-    ros_thread6.join();
+    publish_tf();
+    publish_marker_array();
+    publish_object_state_array();
+    publish_joint_states();
+    publish_base_pose();
+    publish_sensor_data();
+    publish_sensor_data_array();
+    publish_sim_stats();
+
+    publish_scheduler.run(publisher_thread_num);
+}
+
+void MjRos::publish_clock(const mjtNum time)
+{
+    if (MjSim::run_mode == ERunMode::RealTime)
+    {
+        return;
+    }
+
+    // The time jumps back when the robot is reset
+    if (time < last_clock_time || time - last_clock_time >= clock_period - 1E-9)
+    {
+        rosgraph_msgs::Clock clock;
+        clock.clock = MjRos::ros_start + ros::Duration(time);
+        clock_pub.publish(clock);
+        last_clock_time = time;
+    }
+}
+
+void MjRos::step_callback(const std_msgs::UInt32 &msg)
+{
+    MjSim::request_steps(msg.data);
 }
 
 void MjRos::setup_service_servers()
@@ -647,19 +1334,20 @@ void MjRos::get_controlled_joints()
         {
             for (const controller_manager_msgs::ControllerState &controller_state : list_controllers_srv.response.controller)
             {
-                if (controller_state.state.compare("running") == 0 && 
-                    (controller_state.type.find("position_controllers") != std::string::npos ||
-                    controller_state.type.find("velocity_controllers") != std::string::npos ||
-                    controller_state.type.find("effort_controllers") != std::string::npos ||
-                    (custom_controller_type != "" && controller_state.type.find(custom_controller_type) != std::string::npos)))
+                if (controller_state.state.compare("running") == 0 && is_joint_controller_type(controller_state.type))
                 {
+                    mtx.lock();
                     for (const controller_manager_msgs::HardwareInterfaceResources &claimed_resources : controller_state.claimed_resources)
                     {
                         for (const std::string &joint_name : claimed_resources.resources)
                         {
-                            MjSim::controlled_joints.insert(joint_name);
+                            if (MjSim::controlled_joints.insert(joint_name).second)
+                            {
+                                MjSim::controlled_joints_version++;
+                            }
                         }
                     }
+                    mtx.unlock();
                 }
             }
         }
@@ -667,6 +1355,14 @@ void MjRos::get_controlled_joints()
     }
 }
 
+bool MjRos::is_joint_controller_type(const std::string &controller_type) const
+{
+    return controller_type.find("position_controllers") != std::string::npos ||
+           controller_type.find("velocity_controllers") != std::string::npos ||
+           controller_type.find("effort_controllers") != std::string::npos ||
+           (custom_controller_type != "" && controller_type.find(custom_controller_type) != std::string::npos);
+}
+
 bool MjRos::screenshot_service(std_srvs::TriggerRequest &req, std_srvs::TriggerResponse &res)
 {
     std::string save_path_string;
@@ -723,7 +1419,7 @@ bool MjRos::screenshot_service(std_srvs::TriggerRequest &req, std_srvs::TriggerR
 
     ROS_INFO("Trying to save screenshot to [%s]", save_path.c_str());
 
-    if (save_XML(m, save_path.c_str()))
+    if (MjSim::save_model_xml(save_path.c_str()))
     {
         std::function<void(tinyxml2::XMLElement *)> copy_meshes_cb = [&](tinyxml2::XMLElement *mesh_element)
         {
@@ -736,10 +1432,8 @@ bool MjRos::screenshot_service(std_srvs::TriggerRequest &req, std_srvs::TriggerR
                     boost::filesystem::create_directories(new_path);
                 }
                 new_path /= file.filename();
-                if (!boost::filesystem::exists(new_path))
-                {
-                    boost::filesystem::copy_file(file, new_path);
-                }
+                // A screenshot must outlive the meshes it was taken from, so it is never symlinked
+                MjSim::stage_file(file, new_path, MjSim::mesh_staging == EMeshStaging::Copy ? EMeshStaging::Copy : EMeshStaging::Hardlink);
                 mesh_element->SetAttribute("file", boost::filesystem::relative(new_path, save_path.parent_path()).c_str());
             }
         };
@@ -813,12 +1507,13 @@ bool MjRos::reset_robot_service(std_srvs::TriggerRequest &req, std_srvs::Trigger
     reset_robot();
     mtx.unlock();
     ros::Duration(100 * m->opt.timestep).sleep();
+    MjModelReader reader;
     float error_sum = 0.f;
     for (const std::string &robot : MjSim::robot_names)
     {
         for (const std::string &joint_name : MjSim::joint_names[robot])
         {
-            const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
+            const int joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, joint_name);
             if (joint_id != -1)
             {
                 const int qpos_id = m->jnt_qposadr[joint_id];
@@ -856,66 +1551,235 @@ bool MjRos::reset_robot_service(std_srvs::TriggerRequest &req, std_srvs::Trigger
     return true;
 }
 
-bool MjRos::spawn_objects_service(mujoco_msgs::SpawnObjectRequest &req, mujoco_msgs::SpawnObjectResponse &res)
+/**
+ * @brief Queue the request for the spawn and destroy thread, edit_mtx must be locked by the caller
+ *
+ */
+static void queue_edit_request(const std::shared_ptr<EditRequest> &request)
 {
-    std::vector<std::string> names;
+    request->ticket = ++edit_ticket;
+    request->received = std::chrono::steady_clock::now();
+    edit_requests.push_back(request);
+    edit_condition.notify_one();
+}
+
+/**
+ * @brief Wait until the queued request is applied, edit_mtx must be locked by lk
+ *
+ * @return true The request was applied successfully in time
+ * @return false The request failed or timed out, a timed out request is still applied later
+ */
+static bool wait_for_edit(std::unique_lock<std::mutex> &lk, const std::shared_ptr<EditRequest> &request)
+{
+    const std::chrono::duration<double> timeout(spawn_timeout + spawn_coalesce_window);
+    return edit_done_condition.wait_for(lk, timeout, [&]
+                                        { return request->done; }) &&
+           request->success;
+}
+
+/**
+ * @brief Create a request of the spawnable objects, edit_mtx must be locked by the caller
+ *
+ * @param objects Objects of the call, empty names are replaced
+ * @return std::shared_ptr<EditRequest> nullptr if no object can be spawned
+ */
+static std::shared_ptr<EditRequest> make_spawn_request(std::vector<mujoco_msgs::ObjectStatus> &objects)
+{
+    std::shared_ptr<EditRequest> request = std::make_shared<EditRequest>();
+    request->type = mujoco_sim::SpawnStatus::SPAWN;
+    request->nr = spawn_nr++;
+
+    // Objects queued by other calls are spawned by them
+    std::set<std::string> queued_names;
+    for (const std::shared_ptr<EditRequest> &queued_request : edit_requests)
+    {
+        for (const mujoco_msgs::ObjectStatus &object : queued_request->objects_to_spawn)
+        {
+            queued_names.insert(object.info.name);
+        }
+    }
+
     int i = 0;
-    for (mujoco_msgs::ObjectStatus &object : req.objects)
+    for (mujoco_msgs::ObjectStatus &object : objects)
     {
+        MjModelReader reader;
         if (object.info.name.empty())
         {
-            object.info.name = "Object_" + std::to_string(spawn_nr);
+            object.info.name = "Object_" + std::to_string(request->nr);
             if (i++ > 0)
             {
                 object.info.name += "_" + std::to_string(i);
             }
 
-            ROS_WARN("[Spawn #%d] Empty name found, replace to %s", spawn_nr, object.info.name.c_str());
+            ROS_WARN("[Spawn #%d] Empty name found, replace to %s", request->nr, object.info.name.c_str());
         }
-        if (std::find(objects_to_spawn.begin(), objects_to_spawn.end(), object) == objects_to_spawn.end() &&
-            mj_name2id(m, mjtObj::mjOBJ_BODY, object.info.name.c_str()) == -1)
+        if (queued_names.count(object.info.name) == 0 &&
+            get_body_id(object.info.name) == -1 &&
+            !MjSpawnPool::get_instance().is_reserved_name(object.info.name))
         {
-            objects_to_spawn.push_back(object);
-            names.push_back(object.info.name);
+            queued_names.insert(object.info.name);
+            request->objects_to_spawn.push_back(object);
         }
     }
-    if (objects_to_spawn.empty())
+    if (request->objects_to_spawn.empty())
+    {
+        ROS_WARN("[Spawn #%d] Can't find any spawnable object, either the object exists already or there is no object to spawn", request->nr);
+        return nullptr;
+    }
+    return request;
+}
+
+/**
+ * @brief Create a request of the destroyable objects, edit_mtx must be locked by the caller
+ *
+ * @return std::shared_ptr<EditRequest> nullptr if no object can be destroyed
+ */
+static std::shared_ptr<EditRequest> make_destroy_request(const std::vector<std::string> &object_names)
+{
+    std::shared_ptr<EditRequest> request = std::make_shared<EditRequest>();
+    request->type = mujoco_sim::SpawnStatus::DESTROY;
+    request->nr = destroy_nr++;
+
+    for (const std::string &object_name : object_names)
+    {
+        MjModelReader reader;
+        if (spawned_object_names.count(object_name) != 0 || get_body_id(object_name) != -1)
+        {
+            request->object_names_to_destroy.insert(object_name);
+        }
+    }
+    if (request->object_names_to_destroy.empty())
+    {
+        ROS_WARN("[Destroy #%d] Can't find any destroyable object, either the object doesn't exist or there is no object to destroy", request->nr);
+        return nullptr;
+    }
+    return request;
+}
+
+bool MjRos::spawn_objects_service(mujoco_msgs::SpawnObjectRequest &req, mujoco_msgs::SpawnObjectResponse &res)
+{
+    std::unique_lock<std::mutex> lk(edit_mtx);
+    const std::shared_ptr<EditRequest> request = make_spawn_request(req.objects);
+    if (request == nullptr)
     {
         res.names = std::vector<std::string>();
-        ROS_WARN("[Spawn #%d] Can't find any spawnable object, either the object exists already or there is no object to spawn", spawn_nr);
         return true;
     }
 
-    std::unique_lock<std::mutex> lk(spawn_mtx);
-    spawn_success = false;
-    if (condition.wait_until(lk, std::chrono::system_clock::now() + 1000ms, [&]
-                             { return spawn_success; }))
+    std::vector<std::string> names;
+    for (const mujoco_msgs::ObjectStatus &object : request->objects_to_spawn)
+    {
+        names.push_back(object.info.name);
+    }
+
+    queue_edit_request(request);
+    if (wait_for_edit(lk, request))
     {
         MjSim::reload_mesh = true;
         res.names = names;
-        ROS_INFO("[Spawn #%d] Spawned successfully", spawn_nr++);
+        ROS_INFO("[Spawn #%d] Spawned %zu objects successfully in %.2f ms (%.2f ms queued, %zu requests in the edit)",
+                 request->nr, names.size(), request->queue_time + request->edit_time, request->queue_time, request->batch_size);
     }
     else
     {
         res.names = std::vector<std::string>();
-        ROS_WARN("[Spawn #%d] Spawned unsuccessfully", spawn_nr++);
+        ROS_WARN("[Spawn #%d] Spawned unsuccessfully", request->nr);
+    }
+    return true;
+}
+
+bool MjRos::spawn_objects_async_service(mujoco_sim::SpawnObjectAsyncRequest &req, mujoco_sim::SpawnObjectAsyncResponse &res)
+{
+    std::lock_guard<std::mutex> lk(edit_mtx);
+    const std::shared_ptr<EditRequest> request = make_spawn_request(req.objects);
+    if (request == nullptr)
+    {
+        res.ticket = 0;
+        return true;
+    }
+
+    queue_edit_request(request);
+    res.ticket = request->ticket;
+    for (const mujoco_msgs::ObjectStatus &object : request->objects_to_spawn)
+    {
+        res.names.push_back(object.info.name);
     }
+    ROS_INFO("[Spawn #%d] Queued %zu objects with ticket %u", request->nr, res.names.size(), res.ticket);
     return true;
 }
 
 void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
 {
-    // Create add.xml
+    mtx.lock();
+    const std::vector<mujoco_msgs::ObjectStatus> objects_to_compile = claim_objects(spawn_nr, objects);
+    if (objects_to_compile.size() < objects.size())
+    {
+        mj_forward(m, d);
+        spawned_version++;
+    }
+    mtx.unlock();
+
+    if (objects_to_compile.empty())
+    {
+        return;
+    }
+
     tinyxml2::XMLDocument object_xml_doc;
-    tinyxml2::XMLNode *root = object_xml_doc.NewElement("mujoco");
-    object_xml_doc.LinkEndChild(root);
+    add_object_elements(objects_to_compile, object_xml_doc);
+    MjSim::add_data(object_xml_doc);
+
+    mtx.lock();
+    bind_spawned_objects(spawn_nr, objects_to_compile);
+    mj_forward(m, d);
+    spawned_version++;
+    mtx.unlock();
+}
 
-    tinyxml2::XMLElement *worldbody_element = object_xml_doc.NewElement("worldbody");
-    root->LinkEndChild(worldbody_element);
+std::vector<mujoco_msgs::ObjectStatus> MjRos::claim_objects(const int nr, const std::vector<mujoco_msgs::ObjectStatus> &objects)
+{
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
 
+    // Claim free slots of the pool first, only the remaining objects need a recompile
+    std::vector<mujoco_msgs::ObjectStatus> objects_to_compile;
+    objects_to_compile.reserve(objects.size());
     for (const mujoco_msgs::ObjectStatus &object : objects)
     {
-        if (mj_name2id(m, mjtObj::mjOBJ_BODY, object.info.name.c_str()) != -1)
+        const int body_id = mj_spawn_pool.claim(object);
+        if (body_id == -1)
+        {
+            objects_to_compile.push_back(object);
+            continue;
+        }
+
+        ROS_INFO("[Spawn #%d] Spawned body %s from the pool", nr, object.info.name.c_str());
+        spawned_object_names.insert(object.info.name);
+        MjSim::spawned_object_body_names.insert(mj_id2name(m, mjtObj::mjOBJ_BODY, body_id));
+        do_each_child_body_id(m, body_id, [&](int child_body_id)
+                              { MjSim::spawned_object_body_names.insert(mj_id2name(m, mjtObj::mjOBJ_BODY, child_body_id)); });
+    }
+    return objects_to_compile;
+}
+
+void MjRos::add_object_elements(const std::vector<mujoco_msgs::ObjectStatus> &objects, tinyxml2::XMLDocument &object_xml_doc)
+{
+    // Create add.xml
+    tinyxml2::XMLNode *root = object_xml_doc.FirstChildElement("mujoco");
+    if (root == nullptr)
+    {
+        root = object_xml_doc.NewElement("mujoco");
+        object_xml_doc.LinkEndChild(root);
+    }
+
+    tinyxml2::XMLElement *worldbody_element = root->FirstChildElement("worldbody");
+    if (worldbody_element == nullptr)
+    {
+        worldbody_element = object_xml_doc.NewElement("worldbody");
+        root->LinkEndChild(worldbody_element);
+    }
+
+    for (const mujoco_msgs::ObjectStatus &object : objects)
+    {
+        if (get_body_id(object.info.name) != -1)
         {
             ROS_WARN("Object [%s] already exists, ignore...", object.info.name.c_str());
             continue;
@@ -974,106 +1838,82 @@ void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
                     ROS_WARN("Mesh path [%s] is not valid", object_mesh_path.c_str());
                 }
 
-                tinyxml2::XMLDocument mesh_xml_doc;
-                if (!load_XML(mesh_xml_doc, object_mesh_path.c_str()))
+                const tinyxml2::XMLDocument *mesh_xml_doc = get_mjcf_template(object_mesh_path);
+                if (mesh_xml_doc == nullptr)
                 {
                     ROS_WARN("Failed to load file \"%s\"\n", object_mesh_path.c_str());
                     continue;
                 }
 
-                boost::filesystem::path mesh_dir = object_mesh_path.parent_path();
-                for (tinyxml2::XMLNode *node = mesh_xml_doc.FirstChild()->FirstChild();
+                for (const tinyxml2::XMLNode *node = mesh_xml_doc->FirstChild()->FirstChild();
                      node != nullptr;
                      node = node->NextSibling())
                 {
                     tinyxml2::XMLNode *copy = node->DeepClone(&object_xml_doc);
 
-                    // Save path of asset
+                    // The mesh files of the template are already resolved against the meshdir
                     if (strcmp(copy->Value(), "compiler") == 0 && copy->ToElement()->Attribute("meshdir") != nullptr)
                     {
-                        mesh_dir = mesh_dir / copy->ToElement()->Attribute("meshdir");
                         continue;
                     }
 
                     // Change path of asset
                     else if (strcmp(copy->Value(), "asset") == 0)
                     {
-                        do_each_child_element(copy->ToElement(), "mesh", mjtObj::mjOBJ_MESH, add_index);
-
                         std::vector<tinyxml2::XMLElement *> elements_to_remove;
                         do_each_child_element(copy->ToElement(), "mesh", [&](tinyxml2::XMLElement *mesh_element)
                                               {
                                                 if (mesh_element->Attribute("file") != nullptr && mesh_element->Attribute("name") != nullptr)
                                                 {
-                                                    if (mesh_element->Attribute("file")[0] != '/')
+                                                    std::string scale_str = "1 1 1";
+                                                    if (mesh_element->Attribute("scale") != nullptr)
+                                                    {
+                                                        scale_str = mesh_element->Attribute("scale");
+                                                    }
+                                                    std::istringstream iss(scale_str);
+                                                    std::vector<mjtNum> scale = std::vector<mjtNum>{std::istream_iterator<mjtNum>(iss), std::istream_iterator<mjtNum>()};
+
+                                                    if (mju_abs(object.info.size.x) > mjMINVAL || mju_abs(object.info.size.y) > mjMINVAL || mju_abs(object.info.size.z) > mjMINVAL)
                                                     {
-                                                        mesh_element->SetAttribute("file", (mesh_dir / mesh_element->Attribute("file")).c_str());
+                                                        scale[0] *= object.info.size.x;
+                                                        scale[1] *= object.info.size.y;
+                                                        scale[2] *= object.info.size.z;
+                                                        mesh_element->SetAttribute("scale",
+                                                                                (std::to_string(scale[0]) + " " +
+                                                                                    std::to_string(scale[1]) + " " +
+                                                                                    std::to_string(scale[2]))
+                                                                                    .c_str());
                                                     }
-                                                    std::string mesh_name = mesh_element->Attribute("name");
-                                                    if (mesh_paths.find(mesh_name) != mesh_paths.end() || mj_name2id(m, mjtObj::mjOBJ_MESH, mesh_name.c_str()) != -1)
+
+                                                    // Reuse the mesh of the same file and scale
+                                                    const std::string mesh_name = mesh_element->Attribute("name");
+                                                    const std::string mesh_key = std::string(mesh_element->Attribute("file")) + " " + (mesh_element->Attribute("scale") != nullptr ? mesh_element->Attribute("scale") : "");
+                                                    std::map<std::string, std::string>::const_iterator mesh_name_it = mesh_names_of_files.find(mesh_key);
+                                                    if (mesh_name_it != mesh_names_of_files.end() && mesh_paths.find(mesh_name_it->second) != mesh_paths.end())
                                                     {
-                                                        if (mesh_element->Attribute("file", mesh_paths[mesh_name].first.c_str()))
-                                                        {
-                                                            remove:
-                                                            elements_to_remove.push_back(mesh_element);
-                                                        }
-                                                        else
-                                                        {
-                                                            int i = 0;
-                                                            do
-                                                            {
-                                                                const size_t last_underscore_index = mesh_name.find_last_of("_");
-                                                                const std::string string_after_underscore = mesh_name.substr(last_underscore_index + 1);
-                                                                if (string_after_underscore.empty() || string_after_underscore.find_first_not_of("0123456789") != std::string::npos)
-                                                                {
-                                                                    mesh_name += "_" + std::to_string(i);
-                                                                }
-                                                                else
-                                                                {
-                                                                    size_t last_index = mesh_name.find_last_not_of("0123456789");
-                                                                    mesh_name.replace(last_index + 1, i / 10 + 1, std::to_string(i));
-                                                                }
-                                                                if (mj_name2id(m, mjtObj::mjOBJ_MESH, mesh_name.c_str()) != -1 
-                                                                    && mesh_paths.find(mesh_name) != mesh_paths.end() 
-                                                                    && mesh_element->Attribute("file", mesh_paths[mesh_name].first.c_str()))
-                                                                {
-                                                                    goto remove;
-                                                                }
-                                                                
-                                                                i += 1;
-                                                            } while (mj_name2id(m, mjtObj::mjOBJ_MESH, mesh_name.c_str()) != -1 || mesh_paths.find(mesh_name) != mesh_paths.end());
-
-                                                            name_map[mjtObj::mjOBJ_MESH][mesh_element->Attribute("name")] = mesh_name;
-                                                            mesh_element->SetAttribute("name", mesh_name.c_str());
-
-                                                            goto next;
-                                                        }
-                                                    }                                                    
-                                                    else
+                                                        name_map[mjtObj::mjOBJ_MESH][mesh_name] = mesh_name_it->second;
+                                                        elements_to_remove.push_back(mesh_element);
+                                                        return;
+                                                    }
+                                                    std::map<std::string, std::pair<boost::filesystem::path, std::vector<mjtNum>>>::const_iterator mesh_path_it = mesh_paths.find(mesh_name);
+                                                    if (mesh_path_it != mesh_paths.end() && mesh_element->Attribute("file", mesh_path_it->second.first.c_str()) && mesh_path_it->second.second == scale)
                                                     {
-                                                        next:
-                                                        std::string scale_str = "1 1 1";
-                                                        if (mesh_element->Attribute("scale") != nullptr)
-                                                        {
-                                                            scale_str = mesh_element->Attribute("scale");
-                                                        }
-                                                        std::istringstream iss(scale_str);
-                                                        std::vector<mjtNum> scale = std::vector<mjtNum>{std::istream_iterator<mjtNum>(iss), std::istream_iterator<mjtNum>()};
-
-                                                        if (mju_abs(object.info.size.x) > mjMINVAL || mju_abs(object.info.size.y) > mjMINVAL || mju_abs(object.info.size.z) > mjMINVAL)
-                                                        {
-                                                            scale[0] *= object.info.size.x;
-                                                            scale[1] *= object.info.size.y;
-                                                            scale[2] *= object.info.size.z;
-                                                            mesh_element->SetAttribute("scale",
-                                                                                    (std::to_string(scale[0]) + " " +
-                                                                                        std::to_string(scale[1]) + " " +
-                                                                                        std::to_string(scale[2]))
-                                                                                        .c_str());
-                                                        }
-
-                                                        mesh_paths[mesh_element->Attribute("name")] = {mesh_element->Attribute("file"), scale};
+                                                        name_map[mjtObj::mjOBJ_MESH][mesh_name] = mesh_name;
+                                                        mesh_names_of_files[mesh_key] = mesh_name;
+                                                        elements_to_remove.push_back(mesh_element);
+                                                        return;
                                                     }
+
+                                                    std::string unique_mesh_name;
+                                                    do
+                                                    {
+                                                        unique_mesh_name = MjNameRegistry::get_instance().make_unique_name(mjtObj::mjOBJ_MESH, mesh_name);
+                                                    } while (mesh_paths.find(unique_mesh_name) != mesh_paths.end());
+
+                                                    name_map[mjtObj::mjOBJ_MESH][mesh_name] = unique_mesh_name;
+                                                    mesh_element->SetAttribute("name", unique_mesh_name.c_str());
+                                                    mesh_names_of_files[mesh_key] = unique_mesh_name;
+                                                    mesh_paths[unique_mesh_name] = {mesh_element->Attribute("file"), scale};
                                                 } });
 
                         for (tinyxml2::XMLElement *mesh_element : elements_to_remove)
@@ -1085,8 +1925,7 @@ void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
                     }
                 }
 
-                mesh_dir = object_mesh_path.parent_path();
-                for (tinyxml2::XMLNode *node = mesh_xml_doc.FirstChild()->FirstChild();
+                for (const tinyxml2::XMLNode *node = mesh_xml_doc->FirstChild()->FirstChild();
                      node != nullptr;
                      node = node->NextSibling())
                 {
@@ -1109,30 +1948,11 @@ void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
                             ROS_WARN("Body name not found");
                         }
 
-                        do_each_child_element(copy_body_element, mjtObj::mjOBJ_BODY, add_index);
-
-                        do_each_child_element(copy_body_element, "joint", mjtObj::mjOBJ_JOINT, add_index);
+                        do_each_child_element(copy_body_element, mjtObj::mjOBJ_BODY, make_unique_name);
 
-                        do_each_child_element(copy_body_element, "geom", mjtObj::mjOBJ_GEOM, add_index);
+                        do_each_child_element(copy_body_element, "joint", mjtObj::mjOBJ_JOINT, make_unique_name);
 
-                        int i;
-                        do
-                        {
-                            i = unique_index[mjtObj::mjOBJ_BODY];
-                            do_each_child_element(copy_body_element, mjtObj::mjOBJ_BODY, check_index);
-                        } while (i != unique_index[mjtObj::mjOBJ_BODY]);
-
-                        do
-                        {
-                            i = unique_index[mjtObj::mjOBJ_JOINT];
-                            do_each_child_element(copy_body_element, "joint", mjtObj::mjOBJ_JOINT, check_index);
-                        } while (i != unique_index[mjtObj::mjOBJ_JOINT]);
-
-                        do
-                        {
-                            i = unique_index[mjtObj::mjOBJ_GEOM];
-                            do_each_child_element(copy_body_element, "geom", mjtObj::mjOBJ_GEOM, check_index);
-                        } while (i != unique_index[mjtObj::mjOBJ_GEOM]);
+                        do_each_child_element(copy_body_element, "geom", mjtObj::mjOBJ_GEOM, make_unique_name);
 
                         std::function<void(tinyxml2::XMLElement *, const mujoco_msgs::ObjectInfo &)> adjust_body = [](tinyxml2::XMLElement *body_element, const mujoco_msgs::ObjectInfo &info)
                         {
@@ -1270,10 +2090,6 @@ void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
                                                          std::to_string(object.pose.orientation.y) + " " +
                                                          std::to_string(object.pose.orientation.z))
                                                             .c_str());
-
-                        unique_index[mjtObj::mjOBJ_BODY] += 1;
-                        unique_index[mjtObj::mjOBJ_JOINT] += 1;
-                        unique_index[mjtObj::mjOBJ_GEOM] += 1;
                     }
                     else if (strcmp(copy->Value(), "contact") == 0)
                     {
@@ -1376,84 +2192,77 @@ void MjRos::spawn_objects(const std::vector<mujoco_msgs::ObjectStatus> objects)
         worldbody_element->LinkEndChild(body_element);
     }
 
-    if (!save_XML(object_xml_doc, (tmp_model_path.parent_path() / "add.xml").c_str()))
-    {
-        ROS_WARN("Failed to save file \"%s\"\n", (tmp_model_path.parent_path() / "add.xml").c_str());
-        spawn_success = false;
-    }
-    else
-    {
-        spawn_success = MjSim::add_data();
+    MjSpawnPool::get_instance().prepare_slot_elements(root->ToElement());
+}
 
-        mtx.lock();
-        for (const mujoco_msgs::ObjectStatus &object : objects)
+bool MjRos::bind_spawned_objects(const int nr, const std::vector<mujoco_msgs::ObjectStatus> &objects)
+{
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+
+    bool success = true;
+    for (const mujoco_msgs::ObjectStatus &object : objects)
+    {
+        const char *name = object.info.name.c_str();
+        ROS_INFO("[Spawn #%d] Try to spawn body %s", nr, name);
+        int body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, name);
+        if (body_id != -1)
         {
-            const char *name = object.info.name.c_str();
-            ROS_INFO("[Spawn #%d] Try to spawn body %s", spawn_nr, name);
-            int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, name);
-            if (body_id != -1)
+            if (mj_spawn_pool.is_slot_name(name))
             {
-                MjSim::spawned_object_body_names.insert(name);
-                spawned_object_names.insert(name);
-                do_each_child_body_id(m, body_id, [&](int child_body_id)
-                                      { MjSim::spawned_object_body_names.insert(mj_id2name(m, mjtObj::mjOBJ_BODY, child_body_id)); });
+                continue;
+            }
 
-                if (m->body_dofnum[body_id] != 6)
-                {
-                    continue;
-                }
+            MjSim::spawned_object_body_names.insert(name);
+            spawned_object_names.insert(name);
+            spawned_object_infos[name] = object.info;
+            do_each_child_body_id(m, body_id, [&](int child_body_id)
+                                  { MjSim::spawned_object_body_names.insert(mj_id2name(m, mjtObj::mjOBJ_BODY, child_body_id)); });
 
-                int dof_adr = m->jnt_dofadr[m->body_jntadr[body_id]];
-                d->qvel[dof_adr] = object.velocity.linear.x;
-                d->qvel[dof_adr + 1] = object.velocity.linear.y;
-                d->qvel[dof_adr + 2] = object.velocity.linear.z;
-                d->qvel[dof_adr + 3] = object.velocity.angular.x;
-                d->qvel[dof_adr + 4] = object.velocity.angular.y;
-                d->qvel[dof_adr + 5] = object.velocity.angular.z;
-            }
-            else
+            if (m->body_dofnum[body_id] != 6)
             {
-                ROS_WARN("Object %s not found to spawn", name);
-                spawn_success = false;
+                continue;
             }
-        }
 
-        mj_forward(m, d);
-        mtx.unlock();
+            int dof_adr = m->jnt_dofadr[m->body_jntadr[body_id]];
+            d->qvel[dof_adr] = object.velocity.linear.x;
+            d->qvel[dof_adr + 1] = object.velocity.linear.y;
+            d->qvel[dof_adr + 2] = object.velocity.linear.z;
+            d->qvel[dof_adr + 3] = object.velocity.angular.x;
+            d->qvel[dof_adr + 4] = object.velocity.angular.y;
+            d->qvel[dof_adr + 5] = object.velocity.angular.z;
+        }
+        else
+        {
+            ROS_WARN("Object %s not found to spawn", name);
+            success = false;
+        }
     }
-
-    objects_to_spawn.erase(std::remove_if(objects_to_spawn.begin(), objects_to_spawn.end(), [objects](const mujoco_msgs::ObjectStatus &object)
-                                          { return std::find(objects.begin(), objects.end(), object) != objects.end(); }),
-                           objects_to_spawn.end());
+    return success;
 }
 
 bool MjRos::destroy_objects_service(mujoco_msgs::DestroyObjectRequest &req, mujoco_msgs::DestroyObjectResponse &res)
 {
-    for (const std::string &object_name : req.names)
-    {
-        if (mj_name2id(m, mjtObj::mjOBJ_BODY, object_name.c_str()) != -1)
-        {
-            object_names_to_destroy.insert(object_name);
-        }
-    }
+    std::unique_lock<std::mutex> lk(edit_mtx);
+    const std::shared_ptr<EditRequest> request = make_destroy_request(req.names);
 
     std::vector<mujoco_msgs::ObjectState> object_states;
-    if (object_names_to_destroy.empty())
+    if (request == nullptr)
     {
         res.object_states = object_states;
-        ROS_WARN("[Destroy #%d] Can't find any destroyable object, either the object doesn't exist or there is no object to destroy", destroy_nr);
         return true;
     }
-    else
+
+    const std::set<std::string> &object_names_to_destroy = request->object_names_to_destroy;
     {
         const std::size_t objects_num = object_names_to_destroy.size();
         object_states.reserve(objects_num);
 
         for (const std::string &object_name_to_destroy : object_names_to_destroy)
         {
+            MjModelReader reader;
             const char *name = object_name_to_destroy.c_str();
-            ROS_INFO("[Destroy #%d] Try to detroy body %s", destroy_nr, name);
-            int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, name);
+            ROS_INFO("[Destroy #%d] Try to detroy body %s", request->nr, name);
+            int body_id = get_body_id(object_name_to_destroy);
             if (body_id != -1)
             {
                 mujoco_msgs::ObjectState object_state;
@@ -1489,32 +2298,119 @@ bool MjRos::destroy_objects_service(mujoco_msgs::DestroyObjectRequest &req, mujo
         }
     }
 
-    std::unique_lock<std::mutex> lk(destroy_mtx);
-
-    destroy_success = false;
-    if (condition.wait_until(lk, std::chrono::system_clock::now() + 1000ms, [&]
-                             { return destroy_success; }))
+    queue_edit_request(request);
+    if (wait_for_edit(lk, request))
     {
         res.object_states = object_states;
-        ROS_INFO("[Destroy #%d] Destroyed successfully", destroy_nr++);
+        ROS_INFO("[Destroy #%d] Destroyed %zu objects successfully in %.2f ms (%.2f ms queued, %zu requests in the edit)",
+                 request->nr, object_names_to_destroy.size(), request->queue_time + request->edit_time, request->queue_time, request->batch_size);
     }
     else
     {
         res.object_states = std::vector<mujoco_msgs::ObjectState>();
-        ROS_WARN("[Destroy #%d] Destroyed unsuccessfully", destroy_nr++);
+        ROS_WARN("[Destroy #%d] Destroyed unsuccessfully", request->nr);
     }
     return true;
 }
 
-void MjRos::destroy_objects(const std::set<std::string> object_names)
+bool MjRos::destroy_objects_async_service(mujoco_sim::DestroyObjectAsyncRequest &req, mujoco_sim::DestroyObjectAsyncResponse &res)
+{
+    std::lock_guard<std::mutex> lk(edit_mtx);
+    const std::shared_ptr<EditRequest> request = make_destroy_request(req.names);
+    if (request == nullptr)
+    {
+        res.ticket = 0;
+        return true;
+    }
+
+    queue_edit_request(request);
+    res.ticket = request->ticket;
+    res.names.assign(request->object_names_to_destroy.begin(), request->object_names_to_destroy.end());
+    ROS_INFO("[Destroy #%d] Queued %zu objects with ticket %u", request->nr, res.names.size(), res.ticket);
+    return true;
+}
+
+bool MjRos::compact_service(std_srvs::TriggerRequest &req, std_srvs::TriggerResponse &res)
+{
+    std::unique_lock<std::mutex> lk(edit_mtx);
+    const std::shared_ptr<EditRequest> request = std::make_shared<EditRequest>();
+    request->type = mujoco_sim::SpawnStatus::COMPACT;
+
+    queue_edit_request(request);
+    res.success = wait_for_edit(lk, request);
+    res.message = res.success ? "Removed " + std::to_string(request->object_names_to_destroy.size()) + " parked bodies" : "Failed to compact the model";
+    return true;
+}
+
+std::set<std::string> MjRos::release_objects(const std::set<std::string> &object_names)
+{
+    MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+
+    const auto erase_spawned_object_body_names = [](const int body_id)
+    {
+        MjSim::spawned_object_body_names.erase(mj_id2name(m, mjtObj::mjOBJ_BODY, body_id));
+        do_each_child_body_id(m, body_id, [&](int child_body_id)
+                              { MjSim::spawned_object_body_names.erase(mj_id2name(m, mjtObj::mjOBJ_BODY, child_body_id)); });
+    };
+
+    // Give the pooled objects back to the pool, only the remaining objects need a recompile
+    std::set<std::string> object_names_to_remove;
+    for (const std::string &object_name : object_names)
+    {
+        const int body_id = mj_spawn_pool.get_body_id(object_name);
+        if (body_id != -1)
+        {
+            erase_spawned_object_body_names(body_id);
+            mj_spawn_pool.release(object_name);
+            continue;
+        }
+
+        std::map<std::string, mujoco_msgs::ObjectInfo>::const_iterator spawned_object_infos_it = spawned_object_infos.find(object_name);
+        if (soft_destroy &&
+            spawned_object_infos_it != spawned_object_infos.end() &&
+            mj_spawn_pool.adopt(object_name, spawned_object_infos_it->second))
+        {
+            // The body stays in the model as a free slot until the next compaction
+            erase_spawned_object_body_names(MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, object_name));
+            continue;
+        }
+
+        object_names_to_remove.insert(object_name);
+    }
+    return object_names_to_remove;
+}
+
+void MjRos::unbind_destroyed_objects(const std::set<std::string> &object_names)
 {
-    destroy_success = MjSim::remove_body(object_names);
     for (const std::string &object_name : object_names)
     {
-        object_names_to_destroy.erase(object_name);
         MjSim::spawned_object_body_names.erase(object_name);
         spawned_object_names.erase(object_name);
+        spawned_object_infos.erase(object_name);
+    }
+}
+
+/**
+ * @brief Check if the request touches an object of the batch, such requests are applied in a later edit to keep their order
+ *
+ */
+static bool conflicts_with(const EditRequest &request, const std::set<std::string> &names_to_spawn, const std::set<std::string> &names_to_destroy)
+{
+    for (const mujoco_msgs::ObjectStatus &object : request.objects_to_spawn)
+    {
+        if (names_to_destroy.count(object.info.name) != 0)
+        {
+            return true;
+        }
+    }
+    for (const std::string &object_name : request.object_names_to_destroy)
+    {
+        if (names_to_spawn.count(object_name) != 0)
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 void MjRos::spawn_and_destroy_objects()
@@ -1524,66 +2420,52 @@ void MjRos::spawn_and_destroy_objects()
         return;
     }
 
-    ros::Rate loop_rate(spawn_and_destroy_objects_rate);
+    const std::chrono::duration<double> period(1.0 / spawn_and_destroy_objects_rate);
+    const std::chrono::duration<double> coalesce_window(spawn_coalesce_window);
     while (ros::ok())
     {
-        // Spawn objects
-        if (objects_to_spawn.size() > 0)
+        // Take every request which arrived within the window after the first one
+        std::vector<std::shared_ptr<EditRequest>> batch;
+        std::set<std::string> names_to_spawn;
+        std::set<std::string> names_to_destroy;
         {
-            if (pub_tf_rate[EObjectType::SpawnedObject] > 1E-9)
+            std::unique_lock<std::mutex> lk(edit_mtx);
+            if (!edit_condition.wait_for(lk, period, []
+                                         { return !edit_requests.empty(); }))
             {
-                std_msgs::Header header;
-                header.frame_id = root_frame_id;
-                header.stamp = ros::Time::now();
-
-                geometry_msgs::TransformStamped transform;
-                transform.header = header;
-
-                // Publish tf of static objects
-                std::string object_name;
-                for (const mujoco_msgs::ObjectStatus &object : objects_to_spawn)
-                {
-                    const char *name = object.info.name.c_str();
-                    const int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, name);
-                    if (m->body_mocapid[body_id] == -1)
-                    {
-                        continue;
-                    }
-                    set_transform(transform, body_id, name);
-                    static_br.sendTransform(transform);
-                }
+                continue;
             }
 
-            std::unique_lock<std::mutex> lk(spawn_mtx);
+            const auto coalesce_end = edit_requests.front()->received + coalesce_window;
+            lk.unlock();
+            std::this_thread::sleep_until(coalesce_end);
+            lk.lock();
 
-            while (objects_to_spawn.size() > 0)
+            size_t object_num = 0;
+            while (!edit_requests.empty())
             {
-                if (spawn_object_count_per_cycle == -1)
+                const std::shared_ptr<EditRequest> request = edit_requests.front();
+                if (!batch.empty() &&
+                    (conflicts_with(*request, names_to_spawn, names_to_destroy) ||
+                     (spawn_object_count_per_cycle != -1 && object_num + request->objects_to_spawn.size() > (size_t)spawn_object_count_per_cycle)))
                 {
-                    spawn_objects(objects_to_spawn);
+                    break;
                 }
-                else
-                {
-                    std::vector<mujoco_msgs::ObjectStatus> objects;
-                    size_t i = 0;
-                    for (const mujoco_msgs::ObjectStatus &object : objects_to_spawn)
-                    {
-                        if (i++ > spawn_object_count_per_cycle)
-                        {
-                            break;
-                        }
-                        objects.push_back(object);
-                    }
 
-                    spawn_objects(objects);
+                for (const mujoco_msgs::ObjectStatus &object : request->objects_to_spawn)
+                {
+                    names_to_spawn.insert(object.info.name);
                 }
+                names_to_destroy.insert(request->object_names_to_destroy.begin(), request->object_names_to_destroy.end());
+                object_num += request->objects_to_spawn.size();
+                batch.push_back(request);
+                edit_requests.pop_front();
             }
-
-            lk.unlock();
-            condition.notify_all();
         }
 
-        // Destroy objects
+        const std::chrono::steady_clock::time_point edit_start = std::chrono::steady_clock::now();
+
+        // Destroy markers of the objects before their bodies are gone
         visualization_msgs::Marker destroy_marker;
         visualization_msgs::MarkerArray destroy_marker_array;
 
@@ -1597,9 +2479,14 @@ void MjRos::spawn_and_destroy_objects()
 
         destroy_marker.header = header;
 
-        for (const std::string &object_name : object_names_to_destroy)
+        for (const std::string &object_name : names_to_destroy)
         {
-            const int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, object_name.c_str());
+            MjModelReader reader;
+            const int body_id = get_body_id(object_name);
+            if (body_id == -1)
+            {
+                continue;
+            }
             destroy_marker.ns = object_name;
             for (int geom_id = m->body_geomadr[body_id]; geom_id < m->body_geomadr[body_id] + m->body_geomnum[body_id]; geom_id++)
             {
@@ -1612,17 +2499,137 @@ void MjRos::spawn_and_destroy_objects()
             }
         }
 
-        if (object_names_to_destroy.size() > 0)
+        // Apply everything the pool can handle without a recompile
+        MjSpawnPool &mj_spawn_pool = MjSpawnPool::get_instance();
+        std::vector<MjPoolSlot> dead_slots;
+        mtx.lock();
+        bool compact = false;
+        std::set<std::string> names_to_compile;
+        for (const std::shared_ptr<EditRequest> &request : batch)
+        {
+            request->body_names_to_remove = release_objects(request->object_names_to_destroy);
+            request->objects_to_compile = claim_objects(request->nr, request->objects_to_spawn);
+            for (const mujoco_msgs::ObjectStatus &object : request->objects_to_compile)
+            {
+                names_to_compile.insert(object.info.name);
+            }
+            compact |= request->type == mujoco_sim::SpawnStatus::COMPACT;
+        }
+
+        // Parked bodies go all at once when there are too many, or one by one when a new object needs their name
+        if (compact || (soft_destroy && mj_spawn_pool.get_dead_body_ratio() > compact_ratio))
         {
-            std::unique_lock<std::mutex> lk(destroy_mtx);
+            dead_slots = mj_spawn_pool.remove_adopted_slots();
+            ROS_INFO("Compact the model, remove %zu parked bodies", dead_slots.size());
+        }
+        else if (!names_to_compile.empty())
+        {
+            dead_slots = mj_spawn_pool.remove_adopted_slots(names_to_compile);
+        }
+        mj_forward(m, d);
+        spawned_version++;
+        mtx.unlock();
+
+        std::set<std::string> dead_body_names;
+        for (const MjPoolSlot &dead_slot : dead_slots)
+        {
+            dead_body_names.insert(dead_slot.slot_name);
+        }
 
-            while (object_names_to_destroy.size() > 0)
+        for (const std::shared_ptr<EditRequest> &request : batch)
+        {
+            if (request->type == mujoco_sim::SpawnStatus::COMPACT)
             {
-                destroy_objects(object_names_to_destroy);
+                // The first compaction of the batch reports the removed bodies
+                request->object_names_to_destroy.swap(dead_body_names);
+                request->body_names_to_remove = request->object_names_to_destroy;
+                break;
             }
+        }
 
-            lk.unlock();
-            condition.notify_all();
+        // Apply the remaining requests in one model edit
+        tinyxml2::XMLDocument object_xml_doc;
+        std::set<std::string> body_names_to_remove = dead_body_names;
+        size_t edit_num = dead_body_names.empty() ? 0 : 1;
+        for (const std::shared_ptr<EditRequest> &request : batch)
+        {
+            if (!request->objects_to_compile.empty())
+            {
+                add_object_elements(request->objects_to_compile, object_xml_doc);
+            }
+            body_names_to_remove.insert(request->body_names_to_remove.begin(), request->body_names_to_remove.end());
+            if (!request->objects_to_compile.empty() || !request->body_names_to_remove.empty())
+            {
+                edit_num++;
+            }
+        }
+
+        bool dead_bodies_removed = true;
+        if (edit_num > 0 &&
+            !MjSim::edit_data(object_xml_doc.FirstChildElement() != nullptr ? &object_xml_doc : nullptr, body_names_to_remove))
+        {
+            dead_bodies_removed = false;
+        }
+
+        if (!dead_bodies_removed && edit_num > 1)
+        {
+            // One of the requests can't be compiled, apply them one by one so that only the faulty ones fail
+            ROS_WARN("Failed to apply %zu requests in one edit, apply them one by one", edit_num);
+            dead_bodies_removed = dead_body_names.empty() || MjSim::edit_data(nullptr, dead_body_names);
+            for (const std::shared_ptr<EditRequest> &request : batch)
+            {
+                if (request->objects_to_compile.empty() && request->body_names_to_remove.empty())
+                {
+                    continue;
+                }
+
+                tinyxml2::XMLDocument request_xml_doc;
+                if (!request->objects_to_compile.empty())
+                {
+                    add_object_elements(request->objects_to_compile, request_xml_doc);
+                }
+                MjSim::edit_data(request_xml_doc.FirstChildElement() != nullptr ? &request_xml_doc : nullptr, request->body_names_to_remove);
+            }
+        }
+
+        mtx.lock();
+        if (!dead_bodies_removed)
+        {
+            // The parked bodies are still in the model, so the pool keeps them
+            ROS_WARN("Failed to remove %zu parked bodies, keep them in the pool", dead_slots.size());
+            mj_spawn_pool.restore_adopted_slots(dead_slots);
+        }
+        for (const std::shared_ptr<EditRequest> &request : batch)
+        {
+            bind_spawned_objects(request->nr, request->objects_to_compile);
+            unbind_destroyed_objects(request->object_names_to_destroy);
+        }
+        mj_forward(m, d);
+        spawned_version++;
+        mtx.unlock();
+
+        if (pub_tf_rate[EObjectType::SpawnedObject] > 1E-9 && !names_to_spawn.empty())
+        {
+            // Publish tf of static objects, the static broadcaster republishes all its transforms on every call
+            std::vector<geometry_msgs::TransformStamped> transforms;
+            MjModelReader reader;
+            const BodyIndex *current_body_index = MjSnapshotBuffer::get_instance().read(snapshot) ? get_body_index(snapshot) : nullptr;
+            for (int body_id = 1; current_body_index != nullptr && body_id < snapshot.model->nbody; body_id++)
+            {
+                // Bodies of the pool slots are named after their objects, their child bodies too
+                const std::string &object_name = current_body_index->body_names[body_id];
+                if (snapshot.model->body_rootid[body_id] != body_id || snapshot.model->body_mocapid[body_id] == -1 || names_to_spawn.count(object_name) == 0)
+                {
+                    continue;
+                }
+                transforms.emplace_back();
+                transforms.back().header = header;
+                set_transform(transforms.back(), body_id, object_name);
+            }
+            if (!transforms.empty())
+            {
+                static_br.sendTransform(transforms);
+            }
         }
 
         if (destroy_marker_array.markers.size() > 0)
@@ -1631,8 +2638,48 @@ void MjRos::spawn_and_destroy_objects()
             marker_array_pub.publish(destroy_marker_array);
         }
 
-        ros::spinOnce();
-        loop_rate.sleep();
+        // Complete every request with its own result
+        const std::chrono::steady_clock::time_point edit_end = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lk(edit_mtx);
+            MjModelReader reader;
+            for (const std::shared_ptr<EditRequest> &request : batch)
+            {
+                // get_body_id hides parked bodies, so a failed compaction has to be reported here
+                request->success = request->type != mujoco_sim::SpawnStatus::COMPACT || dead_bodies_removed;
+                for (const mujoco_msgs::ObjectStatus &object : request->objects_to_spawn)
+                {
+                    request->success &= get_body_id(object.info.name) != -1;
+                }
+                for (const std::string &object_name : request->object_names_to_destroy)
+                {
+                    request->success &= get_body_id(object_name) == -1;
+                }
+                request->queue_time = std::chrono::duration<double, std::milli>(edit_start - request->received).count();
+                request->edit_time = std::chrono::duration<double, std::milli>(edit_end - edit_start).count();
+                request->batch_size = batch.size();
+                request->done = true;
+            }
+        }
+        edit_done_condition.notify_all();
+
+        for (const std::shared_ptr<EditRequest> &request : batch)
+        {
+            mujoco_sim::SpawnStatus spawn_status;
+            spawn_status.header.stamp = ros::Time::now();
+            spawn_status.ticket = request->ticket;
+            spawn_status.type = request->type;
+            spawn_status.success = request->success;
+            for (const mujoco_msgs::ObjectStatus &object : request->objects_to_spawn)
+            {
+                spawn_status.names.push_back(object.info.name);
+            }
+            spawn_status.names.insert(spawn_status.names.end(), request->object_names_to_destroy.begin(), request->object_names_to_destroy.end());
+            spawn_status.queue_time = request->queue_time;
+            spawn_status.edit_time = request->edit_time;
+            spawn_status.batch_size = request->batch_size;
+            spawn_status_pub.publish(spawn_status);
+        }
     }
 }
 
@@ -1640,12 +2687,9 @@ void MjRos::publish_tf(const EObjectType object_type)
 {
     if (object_type == EObjectType::None)
     {
-        std::thread publish_tf_robot_thread(&MjRos::publish_tf, this, EObjectType::Robot);
-        std::thread publish_tf_world_thread(&MjRos::publish_tf, this, EObjectType::World);
-        std::thread publish_tf_spawned_object_thread(&MjRos::publish_tf, this, EObjectType::SpawnedObject);
-        publish_tf_robot_thread.join();
-        publish_tf_world_thread.join();
-        publish_tf_spawned_object_thread.join();
+        publish_tf(EObjectType::Robot);
+        publish_tf(EObjectType::World);
+        publish_tf(EObjectType::SpawnedObject);
         return;
     }
 
@@ -1654,65 +2698,105 @@ void MjRos::publish_tf(const EObjectType object_type)
         return;
     }
 
-    geometry_msgs::TransformStamped transform;
-
-    ros::Rate loop_rate(pub_tf_rate[object_type]);
+    // Transforms of one cycle, sent in one message and reused by the next cycles
+    std::vector<geometry_msgs::TransformStamped> transforms;
 
     std_msgs::Header header;
     header.frame_id = root_frame_id;
     header.stamp = ros::Time::now();
 
-    transform.header = header;
-
     // Publish tf of static objects
     if (object_type == EObjectType::World || EObjectType::SpawnedObject)
     {
-        std::string object_name;
-        for (int body_id = 1; body_id < m->nbody; body_id++)
+        MjModelReader reader;
+        const BodyIndex *current_body_index = MjSnapshotBuffer::get_instance().read(snapshot) ? get_body_index(snapshot) : nullptr;
+        for (int body_id = 1; current_body_index != nullptr && body_id < snapshot.model->nbody; body_id++)
         {
-            if (m->body_mocapid[body_id] == -1)
+            if (snapshot.model->body_mocapid[body_id] == -1)
             {
                 continue;
             }
-            object_name = mj_id2name(m, mjtObj::mjOBJ_BODY, body_id);
-            set_transform(transform, body_id, object_name);
-            static_br.sendTransform(transform);
+            // Free slots of the spawn pool have no name in the index
+            if (current_body_index->body_names[body_id].empty())
+            {
+                continue;
+            }
+            transforms.emplace_back();
+            transforms.back().header = header;
+            set_transform(transforms.back(), body_id, current_body_index->body_names[body_id]);
+        }
+        if (!transforms.empty())
+        {
+            static_br.sendTransform(transforms);
         }
+        transforms.clear();
     }
 
-    while (ros::ok())
+    MotionFilter motion_filter(pub_tf_of_moved_bodies_only);
+
+    // The bodies of the cycle only change with the model or the spawned objects, so do their frame ids.
+    // Filtered bodies vary from cycle to cycle, their frame ids are always set
+    std::pair<unsigned int, unsigned int> frames_version = {0, 0};
+    bool frames_valid = false;
+    std::function<void()> publish = [this, object_type, header, transforms, motion_filter, frames_version, frames_valid]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
         header.seq += 1;
 
-        transform.header = header;
-
+        size_t transform_num = 0;
         set_ros_msg(*this, object_type, pub_tf_of_free_bodies_only, [&](MjRos &, const int body_id, const EObjectType object_type)
                     {
-                                if (m->body_mocapid[body_id] != -1)
+                                if (transform_num == 0)
+                                {
+                                    const std::pair<unsigned int, unsigned int> version = {snapshot.model_version, spawned_version};
+                                    frames_valid &= version == frames_version;
+                                    frames_version = version;
+                                }
+
+                                const BodyIndex *current_body_index = get_body_index(snapshot);
+                                if (current_body_index == nullptr || snapshot.model->body_mocapid[body_id] != -1)
                                 {
                                     return;
                                 }
 
-                                set_transform(transform, body_id, mj_id2name(m, mjtObj::mjOBJ_BODY, body_id));
-                                br.sendTransform(transform); });
+                                if (transform_num == transforms.size())
+                                {
+                                    transforms.emplace_back();
+                                    transforms.back().header.frame_id = header.frame_id;
+                                    transforms.back().child_frame_id = current_body_index->body_names[body_id];
+                                }
+                                else if (!frames_valid || motion_filter.enabled)
+                                {
+                                    transforms[transform_num].child_frame_id = current_body_index->body_names[body_id];
+                                }
 
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+                                geometry_msgs::TransformStamped &transform = transforms[transform_num++];
+                                transform.header.stamp = header.stamp;
+                                transform.header.seq = header.seq;
+                                set_transform(transform, body_id); },
+                    &motion_filter);
+
+        if (transform_num < transforms.size())
+        {
+            transforms.resize(transform_num);
+        }
+        if (transform_num > 0)
+        {
+            br.sendTransform(transforms);
+            frames_valid = true;
+        }
+    };
+    publish_scheduler.add_job(pub_tf_rate[object_type], publish);
 }
 
 void MjRos::publish_marker_array(const EObjectType object_type)
 {
     if (object_type == EObjectType::None)
     {
-        std::thread publish_marker_array_robot_thread(&MjRos::publish_marker_array, this, EObjectType::Robot);
-        std::thread publish_marker_array_world_thread(&MjRos::publish_marker_array, this, EObjectType::World);
-        std::thread publish_marker_array_spawned_object_thread(&MjRos::publish_marker_array, this, EObjectType::SpawnedObject);
-        publish_marker_array_robot_thread.join();
-        publish_marker_array_world_thread.join();
-        publish_marker_array_spawned_object_thread.join();
+        publish_marker_array(EObjectType::Robot);
+        publish_marker_array(EObjectType::World);
+        publish_marker_array(EObjectType::SpawnedObject);
         return;
     }
 
@@ -1721,18 +2805,23 @@ void MjRos::publish_marker_array(const EObjectType object_type)
         return;
     }
 
-    ros::Rate loop_rate(pub_marker_array_rate[object_type]);
-
     marker[object_type] = visualization_msgs::Marker();
     marker_array[object_type] = visualization_msgs::MarkerArray();
     marker[object_type].action = visualization_msgs::Marker::MODIFY;
     marker[object_type].frame_locked = true;
     marker[object_type].lifetime = ros::Duration(2.0 / pub_marker_array_rate[object_type]);
 
+    MotionFilter motion_filter(pub_object_marker_array_of_moved_bodies_only);
+    if (motion_filter.enabled)
+    {
+        // Markers of bodies at rest are only sent again after the keep alive interval
+        marker[object_type].lifetime = motion_keep_alive_interval > 0.0 ? ros::Duration(2.0 * motion_keep_alive_interval + 2.0 / pub_marker_array_rate[object_type]) : ros::Duration(0.0);
+    }
+
     std_msgs::Header header;
     header.frame_id = root_frame_id;
 
-    while (ros::ok())
+    std::function<void()> publish = [this, object_type, header, motion_filter]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
@@ -1741,29 +2830,30 @@ void MjRos::publish_marker_array(const EObjectType object_type)
         marker[object_type].header = header;
         marker_array[object_type].markers.clear();
 
-        set_ros_msg(*this, object_type, pub_object_marker_array_of_free_bodies_only, &MjRos::add_marker);
+        set_ros_msg(*this, object_type, pub_object_marker_array_of_free_bodies_only, &MjRos::add_marker, &motion_filter);
 
         // Publish markers
-        if (marker_array.size() > 0)
+        if (marker_array[object_type].markers.size() > 0)
         {
             marker_array_pub.publish(marker_array[object_type]);
         }
-
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+    };
+    publish_scheduler.add_job(pub_marker_array_rate[object_type], publish);
 }
 
 void MjRos::publish_object_state_array(const EObjectType object_type)
 {
     if (object_type == EObjectType::None)
     {
-        std::thread publish_object_state_array_robot_thread(&MjRos::publish_object_state_array, this, EObjectType::Robot);
-        std::thread publish_object_state_array_world_thread(&MjRos::publish_object_state_array, this, EObjectType::World);
-        std::thread publish_object_state_array_spawned_object_thread(&MjRos::publish_object_state_array, this, EObjectType::SpawnedObject);
-        publish_object_state_array_robot_thread.join();
-        publish_object_state_array_world_thread.join();
-        publish_object_state_array_spawned_object_thread.join();
+        // Insert the entries of all object types, their jobs may run on different threads
+        for (const EObjectType thread_object_type : {EObjectType::Robot, EObjectType::World, EObjectType::SpawnedObject})
+        {
+            object_state_array[thread_object_type];
+            object_state_nums[thread_object_type] = 0;
+        }
+        publish_object_state_array(EObjectType::Robot);
+        publish_object_state_array(EObjectType::World);
+        publish_object_state_array(EObjectType::SpawnedObject);
         return;
     }
 
@@ -1772,40 +2862,53 @@ void MjRos::publish_object_state_array(const EObjectType object_type)
         return;
     }
 
-    ros::Rate loop_rate(pub_object_state_array_rate[object_type]);
-
     std_msgs::Header header;
     header.frame_id = root_frame_id;
 
-    while (ros::ok())
+    MotionFilter motion_filter(pub_object_state_array_of_moved_bodies_only);
+
+    MjMessagePool<mujoco_msgs::ObjectStateArray> object_state_array_pool;
+    boost::shared_ptr<mujoco_msgs::ObjectStateArray> &current_object_state_array = object_state_array[object_type];
+    size_t &object_state_num = object_state_nums[object_type];
+
+    std::function<void()> publish = [this, object_type, header, motion_filter, object_state_array_pool, &current_object_state_array, &object_state_num]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
         header.seq += 1;
 
-        object_state_array[object_type] = mujoco_msgs::ObjectStateArray();
-        object_state_array[object_type].header = header;
-        object_state_array[object_type].object_states.clear();
+        // Drop the message of the last cycle first, the pool only returns messages held by nobody else
+        current_object_state_array.reset();
+        current_object_state_array = object_state_array_pool.get();
+        current_object_state_array->header = header;
+        object_state_num = 0;
 
-        set_ros_msg(*this, object_type, pub_object_state_array_of_free_bodies_only, &MjRos::add_object_state);
+        set_ros_msg(*this, object_type, pub_object_state_array_of_free_bodies_only, &MjRos::add_object_state, &motion_filter);
 
-        object_state_array_pub.publish(object_state_array[object_type]);
+        // Shrinking keeps the capacity
+        current_object_state_array->object_states.resize(object_state_num);
 
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+        if (!motion_filter.enabled || object_state_num > 0)
+        {
+            object_state_array_pub.publish(current_object_state_array);
+        }
+    };
+    publish_scheduler.add_job(pub_object_state_array_rate[object_type], publish);
 }
 
 void MjRos::publish_joint_states(const EObjectType object_type)
 {
     if (object_type == EObjectType::None)
     {
-        std::thread publish_joint_states_robot_thread(&MjRos::publish_joint_states, this, EObjectType::Robot);
-        std::thread publish_joint_states_world_thread(&MjRos::publish_joint_states, this, EObjectType::World);
-        std::thread publish_joint_states_spawned_object_thread(&MjRos::publish_joint_states, this, EObjectType::SpawnedObject);
-        publish_joint_states_robot_thread.join();
-        publish_joint_states_world_thread.join();
-        publish_joint_states_spawned_object_thread.join();
+        // Insert the entries of all object types, their jobs may run on different threads
+        for (const EObjectType thread_object_type : {EObjectType::Robot, EObjectType::World, EObjectType::SpawnedObject})
+        {
+            joint_states[thread_object_type];
+            joint_state_nums[thread_object_type] = 0;
+        }
+        publish_joint_states(EObjectType::Robot);
+        publish_joint_states(EObjectType::World);
+        publish_joint_states(EObjectType::SpawnedObject);
         return;
     }
 
@@ -1814,11 +2917,13 @@ void MjRos::publish_joint_states(const EObjectType object_type)
         return;
     }
 
-    ros::Rate loop_rate(pub_joint_states_rate[object_type]);
-
     std_msgs::Header header;
 
-    while (ros::ok())
+    MjMessagePool<sensor_msgs::JointState> joint_states_pool;
+    boost::shared_ptr<sensor_msgs::JointState> &current_joint_states = joint_states[object_type];
+    size_t &joint_state_num = joint_state_nums[object_type];
+
+    std::function<void()> publish = [this, object_type, header, joint_states_pool, &current_joint_states, &joint_state_num]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
@@ -1839,24 +2944,26 @@ void MjRos::publish_joint_states(const EObjectType object_type)
             break;
         }
 
-        joint_states[object_type] = sensor_msgs::JointState();
-        joint_states[object_type].header = header;
-
-        joint_states[object_type].name.clear();
-        joint_states[object_type].position.clear();
-        joint_states[object_type].velocity.clear();
-        joint_states[object_type].effort.clear();
+        // Drop the message of the last cycle first, the pool only returns messages held by nobody else
+        current_joint_states.reset();
+        current_joint_states = joint_states_pool.get();
+        current_joint_states->header = header;
+        joint_state_num = 0;
 
         set_ros_msg(*this, object_type, false, &MjRos::add_joint_states);
 
-        if (!joint_states[object_type].name.empty())
+        // Shrinking keeps the capacity
+        current_joint_states->name.resize(joint_state_num);
+        current_joint_states->position.resize(joint_state_num);
+        current_joint_states->velocity.resize(joint_state_num);
+        current_joint_states->effort.resize(joint_state_num);
+
+        if (joint_state_num > 0)
         {
-            joint_states_pub[object_type].publish(joint_states[object_type]);
+            joint_states_pub[object_type].publish(current_joint_states);
         }
-
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+    };
+    publish_scheduler.add_job(pub_joint_states_rate[object_type], publish);
 }
 
 void MjRos::publish_base_pose()
@@ -1866,12 +2973,12 @@ void MjRos::publish_base_pose()
         return;
     }
 
-    ros::Rate loop_rate(pub_base_pose_rate);
-
     std_msgs::Header header;
     header.frame_id = root_frame_id;
 
-    geometry_msgs::TransformStamped transform;
+    // Transforms of the roots, sent in one message per cycle
+    std::vector<geometry_msgs::TransformStamped> transforms;
+    transforms.reserve(MjSim::robot_names.size());
 
     for (const std::string &robot : MjSim::robot_names)
     {
@@ -1880,7 +2987,7 @@ void MjRos::publish_base_pose()
         base_poses[robot] = base_pose;
     }
 
-    while (ros::ok())
+    std::function<void()> publish = [this, header, transforms]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
@@ -1891,15 +2998,23 @@ void MjRos::publish_base_pose()
             base_poses[robot].header = header;
         }
 
-        transform.header = header;
-
         // Publish tf of root
+        MjModelReader reader;
+        if (!MjSnapshotBuffer::get_instance().read(snapshot))
+        {
+            return;
+        }
+
+        transforms.clear();
         int i = 0;
         for (const std::string &robot : MjSim::robot_names)
         {
-            const int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, robot.c_str());
+            const int body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, robot, snapshot.model);
             if (body_id != -1)
             {
+                transforms.emplace_back();
+                geometry_msgs::TransformStamped &transform = transforms.back();
+                transform.header = header;
                 if (MjSim::robot_names.size() > 1)
                 {
                     set_transform(transform, body_id, robot + "/" + root_names[robot]);
@@ -1909,8 +3024,6 @@ void MjRos::publish_base_pose()
                     set_transform(transform, body_id, root_names[robot]);
                 }
 
-                br.sendTransform(transform);
-
                 if (MjSim::add_odom_joints[robot]["lin_odom_x_joint"] ||
                     MjSim::add_odom_joints[robot]["lin_odom_y_joint"] ||
                     MjSim::add_odom_joints[robot]["lin_odom_z_joint"] ||
@@ -1925,9 +3038,12 @@ void MjRos::publish_base_pose()
             i++;
         }
 
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+        if (!transforms.empty())
+        {
+            br.sendTransform(transforms);
+        }
+    };
+    publish_scheduler.add_job(pub_base_pose_rate, publish);
 }
 
 void MjRos::publish_sensor_data()
@@ -1937,200 +3053,256 @@ void MjRos::publish_sensor_data()
         return;
     }
 
-    ros::Rate loop_rate(pub_sensor_data_rate);
-
     std_msgs::Header header;
     geometry_msgs::Vector3Stamped sensor_data;
-    while (ros::ok())
+    std::function<void()> publish = [this, header, sensor_data]() mutable
     {
         // Set header
         header.stamp = ros::Time::now();
 
+        MjModelReader reader;
+        if (!MjSnapshotBuffer::get_instance().read(snapshot))
+        {
+            return;
+        }
+
+        // MjSim::sensors follows m, which may already be newer than the snapshot
+        const mjModel *model = snapshot.model;
         for (const std::pair<size_t, std::string> &sensor : MjSim::sensors)
         {
+            // The other types are published in the sensor data array
+            if (sensor.first >= (size_t)model->nsensor ||
+                (model->sensor_type[sensor.first] != mjtSensor::mjSENS_FORCE && model->sensor_type[sensor.first] != mjtSensor::mjSENS_TORQUE))
+            {
+                continue;
+            }
+
             header.seq += 1;
             header.frame_id = sensor.second;
 
             sensor_data.header = header;
-            const int sensor_adr = m->sensor_adr[sensor.first];
-            sensor_data.vector.x = d->sensordata[sensor_adr];
-            sensor_data.vector.y = d->sensordata[sensor_adr + 1];
-            sensor_data.vector.z = d->sensordata[sensor_adr + 2];
+            const int sensor_adr = model->sensor_adr[sensor.first];
+            sensor_data.vector.x = snapshot.sensordata[sensor_adr];
+            sensor_data.vector.y = snapshot.sensordata[sensor_adr + 1];
+            sensor_data.vector.z = snapshot.sensordata[sensor_adr + 2];
 
             sensors_pub.publish(sensor_data);
         }
-
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+    };
+    publish_scheduler.add_job(pub_sensor_data_rate, publish);
 }
 
-void MjRos::add_marker(const int body_id, const EObjectType object_type)
+void MjRos::publish_sensor_data_array()
 {
-    for (int geom_id = m->body_geomadr[body_id]; geom_id < m->body_geomadr[body_id] + m->body_geomnum[body_id]; geom_id++)
+    if (pub_sensor_data_array_rate < 1E-9)
+    {
+        return;
+    }
+
+    std_msgs::Header header;
+
+    // Names of the model the offsets belong to, the data of another model is only sent after its names
+    mujoco_sim::SensorNames sensor_names;
+    bool has_sensor_names = false;
+    std::vector<uint32_t> offsets;
+
+    MjMessagePool<mujoco_sim::SensorDataArray> sensor_data_array_pool;
+    std::function<void()> publish = [this, header, sensor_names, has_sensor_names, offsets, sensor_data_array_pool]() mutable
     {
-        if (geom_id == -1)
+        // Set header
+        header.stamp = ros::Time::now();
+        header.seq += 1;
+
+        MjModelReader reader;
+        if (!MjSnapshotBuffer::get_instance().read(snapshot))
         {
-            continue;
+            return;
         }
-        boost::filesystem::path mesh_path;
-        switch (m->geom_type[geom_id])
+
+        // Names, offsets and data are all taken from the model of the snapshot
+        const mjModel *model = snapshot.model;
+        if (!has_sensor_names || sensor_names.version != snapshot.model_version)
         {
-        case mjtGeom::mjGEOM_BOX:
-            marker[object_type].type = visualization_msgs::Marker::CUBE;
-            marker[object_type].mesh_resource = "";
-            marker[object_type].scale.x = m->geom_size[3 * geom_id] * 2;
-            marker[object_type].scale.y = m->geom_size[3 * geom_id + 1] * 2;
-            marker[object_type].scale.z = m->geom_size[3 * geom_id + 2] * 2;
-            break;
+            sensor_names.header.stamp = header.stamp;
+            sensor_names.header.seq += 1;
+            sensor_names.version = snapshot.model_version;
+            sensor_names.names.resize(model->nsensor);
+            sensor_names.types.resize(model->nsensor);
+            offsets.resize(model->nsensor);
+            for (int sensor_id = 0; sensor_id < model->nsensor; sensor_id++)
+            {
+                sensor_names.names[sensor_id] = MjSim::get_sensor_name(sensor_id, model);
+                sensor_names.types[sensor_id] = model->sensor_type[sensor_id];
+                offsets[sensor_id] = model->sensor_adr[sensor_id];
+            }
+            sensor_names_pub.publish(sensor_names);
+            has_sensor_names = true;
+        }
 
-        case mjtGeom::mjGEOM_SPHERE:
-            marker[object_type].type = visualization_msgs::Marker::SPHERE;
-            marker[object_type].mesh_resource = "";
-            marker[object_type].scale.x = m->geom_size[3 * geom_id] * 2;
-            marker[object_type].scale.y = m->geom_size[3 * geom_id] * 2;
-            marker[object_type].scale.z = m->geom_size[3 * geom_id] * 2;
-            break;
+        if (model->nsensor == 0)
+        {
+            return;
+        }
 
-        case mjtGeom::mjGEOM_CYLINDER:
-            marker[object_type].type = visualization_msgs::Marker::CYLINDER;
-            marker[object_type].scale.x = m->geom_size[3 * geom_id] * 2;
-            marker[object_type].scale.y = m->geom_size[3 * geom_id] * 2;
-            marker[object_type].scale.z = m->geom_size[3 * geom_id + 1] * 2;
-            break;
+        // Sensors are laid out one after another in sensordata, so the data of all of them is one copy
+        boost::shared_ptr<mujoco_sim::SensorDataArray> sensor_data_array = sensor_data_array_pool.get();
+        sensor_data_array->header = header;
+        sensor_data_array->names_version = sensor_names.version;
+        if (sensor_data_array->offsets != offsets)
+        {
+            sensor_data_array->offsets = offsets;
+        }
+        sensor_data_array->data.assign(snapshot.sensordata, snapshot.sensordata + model->nsensordata);
 
-        case mjtGeom::mjGEOM_MESH:
-            marker[object_type].type = visualization_msgs::Marker::MESH_RESOURCE;
-            mesh_path = boost::filesystem::relative(mesh_paths[mj_id2name(m, mjtObj::mjOBJ_MESH, m->geom_dataid[geom_id])].first, tmp_world_path.parent_path());
-            if (!boost::filesystem::exists(tmp_world_path.parent_path() / mesh_path) || !mesh_path.has_extension())
-            {
-                ROS_WARN("Body %s: Mesh %s - %s not found in [%s]", mj_id2name(m, mjtObj::mjOBJ_BODY, body_id), mj_id2name(m, mjtObj::mjOBJ_MESH, m->geom_dataid[geom_id]), mesh_paths[std::string(mj_id2name(m, mjtObj::mjOBJ_MESH, m->geom_dataid[geom_id]))].first.c_str(), mesh_path.parent_path().c_str());
-                continue;
-            }
-            marker[object_type].mesh_resource = "package://mujoco_sim/model/tmp/" + mesh_path.string();
-            marker[object_type].scale.x = 1;
-            marker[object_type].scale.y = 1;
-            marker[object_type].scale.z = 1;
-            break;
+        sensor_data_array_pub.publish(sensor_data_array);
+    };
+    publish_scheduler.add_job(pub_sensor_data_array_rate, publish);
+}
 
-        default:
-            break;
+void MjRos::publish_sim_stats()
+{
+    if (pub_sim_stats_rate < 1E-9)
+    {
+        return;
+    }
+
+    mujoco_sim::SimStats sim_stats;
+    std::function<void()> publish = [this, sim_stats]() mutable
+    {
+        sim_stats.header.stamp = ros::Time::now();
+        sim_stats.header.seq += 1;
+        sim_stats.real_time_factor = rtf;
+        sim_stats.stall_time = MjSim::stall_time.exchange(0) / 1E6;
+        sim_stats.max_stall_time = MjSim::max_stall_time.exchange(0) / 1E6;
+        sim_stats.steps = MjSim::step_count.exchange(0);
+        sim_stats_pub.publish(sim_stats);
+    };
+    publish_scheduler.add_job(pub_sim_stats_rate, publish);
+}
+
+void MjRos::add_marker(const int body_id, const EObjectType object_type)
+{
+    const MarkerTemplates *current_marker_templates = get_marker_templates(snapshot);
+    const BodyIndex *current_body_index = get_body_index(snapshot);
+    if (current_marker_templates == nullptr || current_body_index == nullptr)
+    {
+        return;
+    }
+
+    const std::string &body_name = current_body_index->body_names[body_id];
+    const mjModel *model = snapshot.model;
+    visualization_msgs::Marker &body_marker = marker[object_type];
+    for (int geom_id = model->body_geomadr[body_id]; geom_id < model->body_geomadr[body_id] + model->body_geomnum[body_id]; geom_id++)
+    {
+        const MarkerTemplate &marker_template = current_marker_templates->geoms[geom_id];
+        if (marker_template.type == -1)
+        {
+            continue;
         }
 
-        marker[object_type].ns = mj_id2name(m, mjtObj::mjOBJ_BODY, body_id);
-        marker[object_type].id = geom_id;
-        marker[object_type].color.a = m->geom_rgba[4 * geom_id + 3];
-        marker[object_type].color.r = m->geom_rgba[4 * geom_id];
-        marker[object_type].color.g = m->geom_rgba[4 * geom_id + 1];
-        marker[object_type].color.b = m->geom_rgba[4 * geom_id + 2];
+        body_marker.type = marker_template.type;
+        body_marker.mesh_resource = marker_template.mesh_resource;
+        body_marker.scale = marker_template.scale;
+        body_marker.color = marker_template.color;
+        body_marker.ns = body_name;
+        body_marker.id = geom_id;
 
-        if (m->geom_type[geom_id] != mjtGeom::mjGEOM_MESH)
+        mjtNum quat[4];
+        if (!marker_template.is_mesh)
         {
-            marker[object_type].pose.position.x = d->geom_xpos[3 * geom_id];
-            marker[object_type].pose.position.y = d->geom_xpos[3 * geom_id + 1];
-            marker[object_type].pose.position.z = d->geom_xpos[3 * geom_id + 2];
+            body_marker.pose.position.x = snapshot.geom_xpos[3 * geom_id];
+            body_marker.pose.position.y = snapshot.geom_xpos[3 * geom_id + 1];
+            body_marker.pose.position.z = snapshot.geom_xpos[3 * geom_id + 2];
 
-            mjtNum quat[4];
-            mjtNum mat[9];
-            for (int i = 0; i < 9; i++)
-            {
-                mat[i] = d->geom_xmat[9 * geom_id + i];
-            }
-            mju_mat2Quat(quat, mat);
-            marker[object_type].pose.orientation.x = quat[1];
-            marker[object_type].pose.orientation.y = quat[2];
-            marker[object_type].pose.orientation.z = quat[3];
-            marker[object_type].pose.orientation.w = quat[0];
+            mju_mat2Quat(quat, snapshot.geom_xmat + 9 * geom_id);
         }
         else
         {
-            mjtNum body_pos[3];
-            body_pos[0] = d->xpos[3 * body_id];
-            body_pos[1] = d->xpos[3 * body_id + 1];
-            body_pos[2] = d->xpos[3 * body_id + 2];
-
-            mjtNum body_quat[4];
-            body_quat[0] = d->xquat[4 * body_id];
-            body_quat[1] = d->xquat[4 * body_id + 1];
-            body_quat[2] = d->xquat[4 * body_id + 2];
-            body_quat[3] = d->xquat[4 * body_id + 3];
-
-            mjtNum geom_pos[3] = {0, 0, 0};
-            if (MjSim::geom_pose.count(geom_id) > 0)
-            {
-                geom_pos[0] = MjSim::geom_pose[geom_id][0];
-                geom_pos[1] = MjSim::geom_pose[geom_id][1];
-                geom_pos[2] = MjSim::geom_pose[geom_id][2];
-            }
+            const mjtNum *body_pos = snapshot.xpos + 3 * body_id;
+            const mjtNum *body_quat = snapshot.xquat + 4 * body_id;
 
             mjtNum pos[3];
-            mju_rotVecQuat(pos, geom_pos, body_quat);
+            mju_rotVecQuat(pos, marker_template.geom_pos, body_quat);
             mju_addTo3(pos, body_pos);
 
-            marker[object_type].pose.position.x = pos[0];
-            marker[object_type].pose.position.y = pos[1];
-            marker[object_type].pose.position.z = pos[2];
-
-            mjtNum geom_quat[4] = {1, 0, 0, 0};
-            if (MjSim::geom_pose.count(geom_id) > 0)
-            {
-                geom_quat[0] = MjSim::geom_pose[geom_id][3];
-                geom_quat[1] = MjSim::geom_pose[geom_id][4];
-                geom_quat[2] = MjSim::geom_pose[geom_id][5];
-                geom_quat[3] = MjSim::geom_pose[geom_id][6];
-            }
-
-            mjtNum quat[4];
-            mju_mulQuat(quat, body_quat, geom_quat);
+            body_marker.pose.position.x = pos[0];
+            body_marker.pose.position.y = pos[1];
+            body_marker.pose.position.z = pos[2];
 
-            marker[object_type].pose.orientation.x = quat[1];
-            marker[object_type].pose.orientation.y = quat[2];
-            marker[object_type].pose.orientation.z = quat[3];
-            marker[object_type].pose.orientation.w = quat[0];
+            mju_mulQuat(quat, body_quat, marker_template.geom_quat);
         }
+        body_marker.pose.orientation.x = quat[1];
+        body_marker.pose.orientation.y = quat[2];
+        body_marker.pose.orientation.z = quat[3];
+        body_marker.pose.orientation.w = quat[0];
 
-        marker_array[object_type].markers.push_back(marker[object_type]);
+        marker_array[object_type].markers.push_back(body_marker);
     }
 }
 
 void MjRos::add_object_state(const int body_id, const EObjectType object_type)
 {
-    mujoco_msgs::ObjectState object_state;
-    object_state.name = mj_id2name(m, mjtObj::mjOBJ_BODY, body_id);
-    object_state.pose.position.x = d->xpos[3 * body_id];
-    object_state.pose.position.y = d->xpos[3 * body_id + 1];
-    object_state.pose.position.z = d->xpos[3 * body_id + 2];
-    object_state.pose.orientation.x = d->xquat[4 * body_id + 1];
-    object_state.pose.orientation.y = d->xquat[4 * body_id + 2];
-    object_state.pose.orientation.z = d->xquat[4 * body_id + 3];
-    object_state.pose.orientation.w = d->xquat[4 * body_id];
-
-    if (m->body_dofnum[body_id] == 6)
-    {
-        const int dof_adr = m->jnt_dofadr[m->body_jntadr[body_id]];
-        object_state.velocity.linear.x = d->qvel[dof_adr];
-        object_state.velocity.linear.y = d->qvel[dof_adr + 1];
-        object_state.velocity.linear.z = d->qvel[dof_adr + 2];
-        object_state.velocity.angular.x = d->qvel[dof_adr + 3];
-        object_state.velocity.angular.y = d->qvel[dof_adr + 4];
-        object_state.velocity.angular.z = d->qvel[dof_adr + 5];
-    }
-
-    object_state_array[object_type].object_states.push_back(object_state);
+    const BodyIndex *current_body_index = get_body_index(snapshot);
+    if (current_body_index == nullptr)
+    {
+        return;
+    }
+
+    std::vector<mujoco_msgs::ObjectState> &object_states = object_state_array[object_type]->object_states;
+    size_t &object_state_num = object_state_nums[object_type];
+    if (object_state_num == object_states.size())
+    {
+        object_states.emplace_back();
+    }
+    mujoco_msgs::ObjectState &object_state = object_states[object_state_num++];
+
+    // Names only change with the model or the spawned objects, so they are rarely written
+    const std::string &body_name = current_body_index->body_names[body_id];
+    if (object_state.name != body_name)
+    {
+        object_state.name = body_name;
+    }
+    object_state.pose.position.x = snapshot.xpos[3 * body_id];
+    object_state.pose.position.y = snapshot.xpos[3 * body_id + 1];
+    object_state.pose.position.z = snapshot.xpos[3 * body_id + 2];
+    object_state.pose.orientation.x = snapshot.xquat[4 * body_id + 1];
+    object_state.pose.orientation.y = snapshot.xquat[4 * body_id + 2];
+    object_state.pose.orientation.z = snapshot.xquat[4 * body_id + 3];
+    object_state.pose.orientation.w = snapshot.xquat[4 * body_id];
+
+    const mjModel *model = snapshot.model;
+    if (model->body_dofnum[body_id] == 6)
+    {
+        const int dof_adr = model->jnt_dofadr[model->body_jntadr[body_id]];
+        object_state.velocity.linear.x = snapshot.qvel[dof_adr];
+        object_state.velocity.linear.y = snapshot.qvel[dof_adr + 1];
+        object_state.velocity.linear.z = snapshot.qvel[dof_adr + 2];
+        object_state.velocity.angular.x = snapshot.qvel[dof_adr + 3];
+        object_state.velocity.angular.y = snapshot.qvel[dof_adr + 4];
+        object_state.velocity.angular.z = snapshot.qvel[dof_adr + 5];
+    }
+    else
+    {
+        object_state.velocity = geometry_msgs::Twist();
+    }
 }
 
 void MjRos::set_transform(geometry_msgs::TransformStamped &transform, const int body_id, const std::string &object_name)
 {
     transform.child_frame_id = object_name;
+    set_transform(transform, body_id);
+}
 
-    transform.transform.translation.x = d->xpos[3 * body_id];
-    transform.transform.translation.y = d->xpos[3 * body_id + 1];
-    transform.transform.translation.z = d->xpos[3 * body_id + 2];
+void MjRos::set_transform(geometry_msgs::TransformStamped &transform, const int body_id)
+{
+    transform.transform.translation.x = snapshot.xpos[3 * body_id];
+    transform.transform.translation.y = snapshot.xpos[3 * body_id + 1];
+    transform.transform.translation.z = snapshot.xpos[3 * body_id + 2];
 
-    const double sqrt_sum_square = mju_sqrt(d->xquat[4 * body_id] * d->xquat[4 * body_id] +
-                                            d->xquat[4 * body_id + 1] * d->xquat[4 * body_id + 1] +
-                                            d->xquat[4 * body_id + 2] * d->xquat[4 * body_id + 2] +
-                                            d->xquat[4 * body_id + 3] * d->xquat[4 * body_id + 3]);
+    const double sqrt_sum_square = mju_sqrt(snapshot.xquat[4 * body_id] * snapshot.xquat[4 * body_id] +
+                                            snapshot.xquat[4 * body_id + 1] * snapshot.xquat[4 * body_id + 1] +
+                                            snapshot.xquat[4 * body_id + 2] * snapshot.xquat[4 * body_id + 2] +
+                                            snapshot.xquat[4 * body_id + 3] * snapshot.xquat[4 * body_id + 3]);
 
     if (mju_abs(sqrt_sum_square) < mjMINVAL)
     {
@@ -2141,29 +3313,30 @@ void MjRos::set_transform(geometry_msgs::TransformStamped &transform, const int
     }
     else
     {
-        transform.transform.rotation.x = d->xquat[4 * body_id + 1] / sqrt_sum_square;
-        transform.transform.rotation.y = d->xquat[4 * body_id + 2] / sqrt_sum_square;
-        transform.transform.rotation.z = d->xquat[4 * body_id + 3] / sqrt_sum_square;
-        transform.transform.rotation.w = d->xquat[4 * body_id] / sqrt_sum_square;
+        transform.transform.rotation.x = snapshot.xquat[4 * body_id + 1] / sqrt_sum_square;
+        transform.transform.rotation.y = snapshot.xquat[4 * body_id + 2] / sqrt_sum_square;
+        transform.transform.rotation.z = snapshot.xquat[4 * body_id + 3] / sqrt_sum_square;
+        transform.transform.rotation.w = snapshot.xquat[4 * body_id] / sqrt_sum_square;
     }
 }
 
 void MjRos::set_base_pose(const int body_id, const std::string &robot)
 {
-    base_poses[robot].pose.pose.position.x = d->xpos[3 * body_id];
-    base_poses[robot].pose.pose.position.y = d->xpos[3 * body_id + 1];
-    base_poses[robot].pose.pose.position.z = d->xpos[3 * body_id + 2];
-    base_poses[robot].pose.pose.orientation.x = d->xquat[4 * body_id + 1];
-    base_poses[robot].pose.pose.orientation.y = d->xquat[4 * body_id + 2];
-    base_poses[robot].pose.pose.orientation.z = d->xquat[4 * body_id + 3];
-    base_poses[robot].pose.pose.orientation.w = d->xquat[4 * body_id];
+    base_poses[robot].pose.pose.position.x = snapshot.xpos[3 * body_id];
+    base_poses[robot].pose.pose.position.y = snapshot.xpos[3 * body_id + 1];
+    base_poses[robot].pose.pose.position.z = snapshot.xpos[3 * body_id + 2];
+    base_poses[robot].pose.pose.orientation.x = snapshot.xquat[4 * body_id + 1];
+    base_poses[robot].pose.pose.orientation.y = snapshot.xquat[4 * body_id + 2];
+    base_poses[robot].pose.pose.orientation.z = snapshot.xquat[4 * body_id + 3];
+    base_poses[robot].pose.pose.orientation.w = snapshot.xquat[4 * body_id];
     base_poses[robot].pose.covariance.assign(0.0);
     base_poses[robot].twist.covariance.assign(0.0);
 }
 
 void MjRos::add_joint_states(const int body_id, const EObjectType object_type)
 {
-    if (m->body_jntnum[body_id] == 1 && (m->jnt_type[m->body_jntadr[body_id]] == mjtJoint::mjJNT_HINGE || m->jnt_type[m->body_jntadr[body_id]] == mjtJoint::mjJNT_SLIDE))
+    const mjModel *model = snapshot.model;
+    if (model->body_jntnum[body_id] == 1 && (model->jnt_type[model->body_jntadr[body_id]] == mjtJoint::mjJNT_HINGE || model->jnt_type[model->body_jntadr[body_id]] == mjtJoint::mjJNT_SLIDE))
     {
         if (object_type == EObjectType::SpawnedObject)
         {
@@ -2171,24 +3344,39 @@ void MjRos::add_joint_states(const int body_id, const EObjectType object_type)
             std::string parent_body_name;
             do
             {
-                parent_body_id = m->body_parentid[parent_body_id];
+                parent_body_id = model->body_parentid[parent_body_id];
                 if (parent_body_id == -1)
                 {
                     break;
                 }
-                parent_body_name = mj_id2name(m, mjtObj::mjOBJ_BODY, parent_body_id);
+                parent_body_name = mj_id2name(model, mjtObj::mjOBJ_BODY, parent_body_id);
             } while (spawned_object_names.find(parent_body_name) == spawned_object_names.end());
 
-            joint_states[object_type].header.frame_id = parent_body_name;
+            joint_states[object_type]->header.frame_id = parent_body_name;
+        }
+        const int joint_id = model->body_jntadr[body_id];
+        const char *joint_name = mj_id2name(model, mjtObj::mjOBJ_JOINT, joint_id);
+        const int qpos_id = model->jnt_qposadr[joint_id];
+        const int dof_id = model->jnt_dofadr[joint_id];
+
+        sensor_msgs::JointState &joint_state = *joint_states[object_type];
+        size_t &joint_state_num = joint_state_nums[object_type];
+        if (joint_state_num == joint_state.name.size())
+        {
+            joint_state.name.emplace_back();
+            joint_state.position.emplace_back();
+            joint_state.velocity.emplace_back();
+            joint_state.effort.emplace_back();
         }
-        const int joint_id = m->body_jntadr[body_id];
-        const char *joint_name = mj_id2name(m, mjtObj::mjOBJ_JOINT, joint_id);
-        const int qpos_id = m->jnt_qposadr[joint_id];
-        const int dof_id = m->jnt_dofadr[joint_id];
 
-        joint_states[object_type].name.push_back(joint_name);
-        joint_states[object_type].position.push_back(d->qpos[qpos_id]);
-        joint_states[object_type].velocity.push_back(d->qvel[dof_id]);
-        joint_states[object_type].effort.push_back(d->qfrc_inverse[dof_id]);
+        // Names only change with the model, so they are rarely written
+        if (joint_state.name[joint_state_num] != joint_name)
+        {
+            joint_state.name[joint_state_num] = joint_name;
+        }
+        joint_state.position[joint_state_num] = snapshot.qpos[qpos_id];
+        joint_state.velocity[joint_state_num] = snapshot.qvel[dof_id];
+        joint_state.effort[joint_state_num] = snapshot.efforts[dof_id];
+        joint_state_num++;
     }
 }
\ No newline at end of file
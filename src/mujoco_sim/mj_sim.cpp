@@ -19,18 +19,40 @@
 // SOFTWARE.
 
 #include "mj_sim.h"
+#include "mj_model_cache.h"
+#include "mj_name_registry.h"
+#include "mj_spawn_pool.h"
+#include "mj_state_migration.h"
 
 #include "mj_util.h"
 
+#include <condition_variable>
+#include <cstring>
 #include <ros/package.h>
 #include <tf/tf.h>
 #include <tf2/LinearMath/Quaternion.h>
 
 double MjSim::max_time_step;
 
+double MjSim::real_time_factor = 1.0;
+
+ERunMode MjSim::run_mode = ERunMode::RealTime;
+
+EMeshStaging MjSim::mesh_staging = EMeshStaging::Copy;
+
+static std::mutex step_mtx;
+
+static std::condition_variable step_cv;
+
+static unsigned int requested_step_num = 0;
+
 std::map<std::string, std::vector<std::string>> MjSim::joint_names;
 
-std::map<std::string, mjtNum> MjSim::odom_vels;
+std::map<std::string, MjOdomPlan> MjSim::odom_plans;
+
+const std::vector<std::string> MjSim::odom_joint_names = {"lin_odom_x_joint", "lin_odom_y_joint", "lin_odom_z_joint", "ang_odom_x_joint", "ang_odom_y_joint", "ang_odom_z_joint"};
+
+static unsigned int odom_plans_model_version = 0;
 
 std::set<std::string> MjSim::robot_link_names;
 
@@ -40,12 +62,31 @@ mjtNum *MjSim::ddq = NULL;
 
 mjtNum *MjSim::tau = NULL;
 
+EEffortSource MjSim::effort_source = EEffortSource::InverseDynamics;
+
+mjtNum *MjSim::efforts = NULL;
+
 mjtNum MjSim::sim_start;
 
 std::map<std::string, std::map<std::string, bool>> MjSim::add_odom_joints;
 
 std::set<std::string> MjSim::controlled_joints;
 
+std::atomic<unsigned int> MjSim::controlled_joints_version(0);
+
+std::atomic<unsigned long long> MjSim::stall_time(0);
+
+std::atomic<unsigned long long> MjSim::max_stall_time(0);
+
+std::atomic<unsigned int> MjSim::step_count(0);
+
+// Dof ids of the controlled joints, resolved once per model and per change of the controlled joints
+static std::vector<int> controlled_dof_ids;
+
+static unsigned int controlled_dof_ids_model_version = 0;
+
+static unsigned int controlled_dof_ids_joints_version = 0;
+
 std::set<std::string> MjSim::robot_names;
 
 std::map<size_t, std::string> MjSim::sensors;
@@ -59,22 +100,53 @@ std::set<std::string> MjSim::spawned_object_body_names;
 // Fix bug from m->geom_pos and m->geom_quat
 std::map<int, std::vector<mjtNum>> MjSim::geom_pose;
 
+std::atomic<unsigned int> MjSim::geom_pose_version(0);
+
 bool MjSim::disable_gravity = true;
 
+// False while m is loaded from the model cache, mj_saveLastXML needs a model compiled from xml
+static bool model_from_xml = false;
+
+// Model files of the current model, spawning and destroying edit them in memory and compile them from vfs
+static std::mutex xml_mtx;
+
+static tinyxml2::XMLDocument tmp_model_doc;
+
+static tinyxml2::XMLDocument cache_model_doc;
+
+static mjVFS *vfs = nullptr;
+
+// model_path parsed once at startup, shared by the robot name lookup and init_tmp
+static tinyxml2::XMLDocument model_doc;
+
 MjSim::~MjSim()
 {
 	mju_free(tau);
-	boost::filesystem::remove_all(tmp_model_path.parent_path());
+	mju_free(efforts);
+	if (vfs != nullptr)
+	{
+		mj_deleteVFS(vfs);
+		mju_free(vfs);
+	}
+	// Keep the model cache for the next start
+	if (boost::filesystem::exists(tmp_model_path.parent_path()))
+	{
+		for (const boost::filesystem::directory_entry &entry : boost::filesystem::directory_iterator(tmp_model_path.parent_path()))
+		{
+			if (entry.path().filename() != "cache")
+			{
+				boost::filesystem::remove_all(entry.path());
+			}
+		}
+	}
 }
 
+/**
+ * @brief Collect the joints of the robots from cache_model_doc, odom joints are skipped
+ */
 static void set_joint_names()
 {
-	tinyxml2::XMLDocument cache_model_xml_doc;
-	if (!load_XML(cache_model_xml_doc, model_path.c_str()))
-	{
-		ROS_WARN("Failed to load file \"%s\"\n", model_path.c_str());
-		return;
-	}
+	tinyxml2::XMLDocument &cache_model_xml_doc = cache_model_doc;
 	if (cache_model_xml_doc.FirstChildElement()->FirstChildElement("worldbody") == nullptr)
 	{
 		ROS_WARN("%s doesn't have <worldbody>", model_path.c_str());
@@ -178,11 +250,9 @@ static void save_mesh_paths(tinyxml2::XMLDocument &doc, const boost::filesystem:
 
 /**
  * @brief Create tmp_model_mesh_path and copy model meshes there,
- * add world to tmp_model_path,
- * copy model.xml to cache_model_path and add odom joints if required,
- * include cache_model_path into tmp_model_path
+ * set cache_model_path and tmp_model_path
  */
-static void init_tmp()
+static void init_tmp_paths()
 {
 	ROS_INFO("Copying model in %s...", tmp_model_path.parent_path().c_str());
 	// Remove directory tmp_model_path if exist and tmp_model_path doesn't contain model_path
@@ -205,33 +275,34 @@ static void init_tmp()
 		boost::filesystem::create_directories(tmp_world_mesh_path);
 	}
 
-	// Copy model meshes to tmp_world_mesh_path (to save .dae files)
+	// Stage model meshes in tmp_world_mesh_path (to save .dae files)
 	if (boost::filesystem::exists(world_path.parent_path() / world_path_tail))
 	{
 		for (const boost::filesystem::directory_entry &file : boost::filesystem::directory_iterator(world_path.parent_path() / world_path_tail))
 		{
-			boost::filesystem::path des_file_path = tmp_world_mesh_path / file.path().filename();
-			if (!boost::filesystem::exists(des_file_path))
-			{
-				boost::filesystem::copy_file(file.path(), des_file_path);
-			}
+			MjSim::stage_file(file.path(), tmp_world_mesh_path / file.path().filename(), MjSim::mesh_staging);
 		}
 	}
 
-	// Copy model file to cache_model_path
 	cache_model_path = tmp_model_path / model_path.filename();
-	if (!boost::filesystem::exists(cache_model_path))
-	{
-		boost::filesystem::copy_file(model_path, cache_model_path);
-	}
+	tmp_model_path /= tmp_model_name;
+}
 
+/**
+ * @brief Build tmp_model_doc from the world and cache_model_doc from the model in memory,
+ * add odom joints, gravcomp and pose_init, make the asset paths absolute,
+ * include cache_model_path into tmp_model_path and save both files once
+ *
+ * @return true if succeed
+ */
+static bool init_tmp()
+{
 	// Add world to tmp_model_path
-	tmp_model_path /= tmp_model_name;
-	tinyxml2::XMLDocument current_xml_doc;
+	tinyxml2::XMLDocument &current_xml_doc = tmp_model_doc;
 	if (!load_XML(current_xml_doc, world_path.c_str()))
 	{
 		ROS_WARN("Failed to load file \"%s\"\n", world_path.c_str());
-		return;
+		return false;
 	}
 	boost::filesystem::path meshdir_abs_path = world_path.parent_path();
 	for (tinyxml2::XMLElement *compiler_element = current_xml_doc.FirstChildElement()->FirstChildElement("compiler");
@@ -262,14 +333,14 @@ static void init_tmp()
 
 	include_element->SetAttribute("file", boost::filesystem::relative(cache_model_path, tmp_model_path.parent_path()).c_str());
 
-	save_XML(current_xml_doc, tmp_model_path.c_str());
-
-	tinyxml2::XMLDocument cache_model_xml_doc;
-	if (!load_XML(cache_model_xml_doc, cache_model_path.c_str()))
+	const tinyxml2::XMLDocument *parsed_model_doc = MjSim::get_model_doc();
+	if (parsed_model_doc == nullptr)
 	{
-		ROS_WARN("Failed to load file \"%s\"\n", cache_model_path.c_str());
-		return;
+		return false;
 	}
+	tinyxml2::XMLDocument &cache_model_xml_doc = cache_model_doc;
+	parsed_model_doc->DeepCopy(&cache_model_xml_doc);
+	model_doc.Clear();
 
 	meshdir_abs_path = model_path.parent_path();
 	for (tinyxml2::XMLElement *compiler_element = cache_model_xml_doc.FirstChildElement()->FirstChildElement("compiler");
@@ -420,141 +491,10 @@ static void init_tmp()
 		}
 	}
 
-	for (tinyxml2::XMLElement *asset_element = cache_model_xml_doc.FirstChildElement()->FirstChildElement("asset");
-		 asset_element != nullptr;
-		 asset_element = asset_element->NextSiblingElement("asset"))
-	{
-		for (tinyxml2::XMLElement *texture_element = asset_element->FirstChildElement("texture");
-			 texture_element != nullptr;
-			 texture_element = texture_element->NextSiblingElement("texture"))
-		{
-			if (texture_element->Attribute("file") != nullptr)
-			{
-				const boost::filesystem::path file_path = texture_element->Attribute("file");
-				if (file_path.is_relative())
-				{
-					texture_element->SetAttribute("file", (meshdir_abs_path / file_path).c_str());
-				}
-			}
-		}
-		for (tinyxml2::XMLElement *mesh_element = asset_element->FirstChildElement("mesh");
-			 mesh_element != nullptr;
-			 mesh_element = mesh_element->NextSiblingElement("mesh"))
-		{
-			if (mesh_element->Attribute("file") != nullptr)
-			{
-				const boost::filesystem::path file_path = mesh_element->Attribute("file");
-				if (file_path.is_relative())
-				{
-					mesh_element->SetAttribute("file", (meshdir_abs_path / file_path).c_str());
-				}
-			}
-		}
-	}
-
+	save_XML(current_xml_doc, tmp_model_path.c_str());
 	save_XML(cache_model_xml_doc, cache_model_path.c_str());
 	ROS_INFO("Save models in %s successfully", tmp_model_path.parent_path().c_str());
-}
-
-/**
- * @brief Add the old state to the new state
- *
- * @param m_new New mjModel*
- * @param d_new New mjData*
- */
-static void add_old_state(mjModel *m_new, mjData *d_new)
-{
-	d_new->time = d->time;
-
-	int body_id = 0;
-	while (true)
-	{
-		body_id++;
-		const char *name = mj_id2name(m, mjtObj::mjOBJ_BODY, body_id);
-		if (name == nullptr)
-		{
-			break;
-		}
-
-		int body_id_new = mj_name2id(m_new, mjtObj::mjOBJ_BODY, name);
-		if (body_id_new == -1)
-		{
-			continue;
-		}
-
-		// Copy body position
-		d_new->xpos[body_id_new] = d->xpos[body_id];
-		d_new->xpos[body_id_new + 1] = d->xpos[body_id + 1];
-		d_new->xpos[body_id_new + 2] = d->xpos[body_id + 2];
-
-		// Copy body rotation
-		d_new->xquat[body_id_new] = d->xquat[body_id];
-		d_new->xquat[body_id_new + 1] = d->xquat[body_id + 1];
-		d_new->xquat[body_id_new + 2] = d->xquat[body_id + 2];
-		d_new->xquat[body_id_new + 3] = d->xquat[body_id + 3];
-
-		// Copy body states
-		for (int body_nr = 0; body_nr < 6; body_nr++)
-		{
-			d_new->xfrc_applied[body_id_new + body_nr] = d->xfrc_applied[body_id + body_nr];
-		}
-
-		// Copy joint states
-		int jnt_num = m->body_jntnum[body_id];
-		int jnt_num_new = m_new->body_jntnum[body_id_new];
-		if (jnt_num == jnt_num_new)
-		{
-			int qpos_adr = m->jnt_qposadr[m->body_jntadr[body_id]];
-			int qpos_adr_new = m_new->jnt_qposadr[m_new->body_jntadr[body_id_new]];
-			for (int jnt_nr = 0; jnt_nr < jnt_num; jnt_nr++)
-			{
-				d_new->qpos[qpos_adr_new + jnt_nr] = d->qpos[qpos_adr + jnt_nr];
-			}
-		}
-		else
-		{
-			ROS_WARN("Old [%s] has %d joints != new [%s] has %d joints", name, jnt_num, name, jnt_num_new);
-		}
-
-		// Copy dof states
-		int dof_num = m->body_dofnum[body_id];
-		int dof_num_new = m_new->body_dofnum[body_id_new];
-		if (dof_num == dof_num_new)
-		{
-			int dof_adr = m->jnt_dofadr[m->body_jntadr[body_id]];
-			int dof_adr_new = m_new->jnt_dofadr[m_new->body_jntadr[body_id_new]];
-			for (int dof_nr = 0; dof_nr < dof_num; dof_nr++)
-			{
-				d_new->qvel[dof_adr_new + dof_nr] = d->qvel[dof_adr + dof_nr];
-				d_new->qacc_warmstart[dof_adr_new + dof_nr] = d->qacc_warmstart[dof_adr + dof_nr];
-				d_new->qfrc_applied[dof_adr_new + dof_nr] = d->qfrc_applied[dof_adr + dof_nr];
-				d_new->qacc[dof_adr_new + dof_nr] = d->qacc[dof_adr + dof_nr];
-			}
-		}
-		else
-		{
-			ROS_WARN("Old [%s] has %d dofs != new [%s] has %d dofs", name, dof_num, name, dof_num_new);
-		}
-	}
-
-	// Copy activation states
-	if (m->na != 0 || m_new->na != 0)
-	{
-		ROS_WARN("Old model has %d activation states, new model has %d activation states, not supported, will be ignored...", m->na, m_new->na);
-	}
-
-	// Copy sensor data
-	if (m->nsensordata != m_new->nsensordata)
-	{
-		ROS_WARN("Old model has %d sensors, new model has %d sensors, not supported, will be ignored...", m->nsensordata, m_new->nsensordata);
-	}
-	else
-	{
-		mju_copy(d_new->sensordata, d->sensordata, m->nsensordata);
-	}
-
-	d = d_new;
-	m = m_new;
+	return true;
 }
 
 /**
@@ -562,35 +502,37 @@ static void add_old_state(mjModel *m_new, mjData *d_new)
  */
 static void init_malloc()
 {
+	mju_free(MjSim::tau);
+	mju_free(MjSim::ddq);
+	mju_free(MjSim::dq);
+	mju_free(MjSim::efforts);
 	MjSim::tau = (mjtNum *)mju_malloc(m->nv * sizeof(mjtNum *));
 	mju_zero(MjSim::tau, m->nv);
 	MjSim::ddq = (mjtNum *)mju_malloc(m->nv * sizeof(mjtNum *));
 	mju_zero(MjSim::ddq, m->nv);
 	MjSim::dq = (mjtNum *)mju_malloc(m->nv * sizeof(mjtNum *));
 	mju_zero(MjSim::dq, m->nv);
+	MjSim::efforts = (mjtNum *)mju_malloc(m->nv * sizeof(mjtNum));
+	mju_zero(MjSim::efforts, m->nv);
 }
 
-static void modify_xml(const char *xml_path, const std::set<std::string> &remove_body_names = {""})
+static void modify_xml(tinyxml2::XMLDocument &doc, const std::set<std::string> &remove_body_names = {""})
 {
-	tinyxml2::XMLDocument doc;
-	if (!load_XML(doc, xml_path))
-	{
-		ROS_WARN("Failed to load file \"%s\"\n", xml_path);
-		return;
-	}
-
-	mtx.lock();
-
 	std::function<void(tinyxml2::XMLElement *)> add_bound_cb = [&](tinyxml2::XMLElement *compiler_element)
 	{
 		compiler_element->SetAttribute("boundmass", "0.000001");
 		compiler_element->SetAttribute("boundinertia", "0.000001");
 	};
 
+	if (doc.FirstChildElement()->FirstChildElement("compiler") == nullptr)
+	{
+		doc.FirstChildElement()->InsertFirstChild(doc.NewElement("compiler"));
+	}
 	do_each_child_element(doc.FirstChildElement(), "compiler", add_bound_cb);
 
 	tinyxml2::XMLElement *worldbody_element = doc.FirstChildElement()->FirstChildElement();
 	std::set<tinyxml2::XMLElement *> body_elements_to_delete;
+	mtx.lock();
 	for (tinyxml2::XMLElement *worldbody_element = doc.FirstChildElement()->FirstChildElement("worldbody");
 		 worldbody_element != nullptr;
 		 worldbody_element = worldbody_element->NextSiblingElement("worldbody"))
@@ -609,7 +551,7 @@ static void modify_xml(const char *xml_path, const std::set<std::string> &remove
 					 MjSim::robot_link_names.find(body_name) == MjSim::robot_link_names.end() &&
 					 MjSim::robot_names.find(body_name) == MjSim::robot_names.end())
 			{
-				const int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, body_name);
+				const int body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, body_name);
 				body_element->SetAttribute("pos",
 										   (std::to_string(d->xpos[3 * body_id]) + " " +
 											std::to_string(d->xpos[3 * body_id + 1]) + " " +
@@ -624,6 +566,7 @@ static void modify_xml(const char *xml_path, const std::set<std::string> &remove
 			}
 		}
 	}
+	mtx.unlock();
 
 	if (body_elements_to_delete.size() > 0)
 	{
@@ -703,25 +646,14 @@ static void modify_xml(const char *xml_path, const std::set<std::string> &remove
 			}
 		}
 	}
-
-	save_XML(doc, xml_path);
-
-	mtx.unlock();
 }
 
 /***********************************/
 /* Fix bug for m->geom_quat begins */
 /***********************************/
-bool save_geom_quat(const char *path)
+bool save_geom_quat(tinyxml2::XMLDocument &xml_doc)
 {
 	mtx.lock();
-	tinyxml2::XMLDocument xml_doc;
-	if (!load_XML(xml_doc, path))
-	{
-		ROS_WARN("Failed to load file \"%s\"\n", path);
-		return false;
-	}
-
 	for (tinyxml2::XMLElement *worldbody_element = xml_doc.FirstChildElement()->FirstChildElement("worldbody");
 		 worldbody_element != nullptr;
 		 worldbody_element = worldbody_element->NextSiblingElement("worldbody"))
@@ -772,7 +704,7 @@ bool save_geom_quat(const char *path)
 																quat.setRPY(euler[0], euler[1], euler[2]);
 																std::vector<mjtNum> geom_quat = {quat.getW(), quat.getX(), quat.getY(), quat.getZ()};
 
-																const int mesh_id = mj_name2id(m, mjtObj::mjOBJ_MESH, element->Attribute("mesh"));
+																const int mesh_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_MESH, element->Attribute("mesh"));
 																for (int geom_id = 0; geom_id < m->ngeom; geom_id++)
 																{
 																	if (m->geom_dataid[geom_id] == mesh_id && MjSim::geom_pose.find(geom_id) == MjSim::geom_pose.end())
@@ -788,6 +720,7 @@ bool save_geom_quat(const char *path)
 
 		do_each_child_element(worldbody_element, "geom", func);
 	}
+	MjSim::geom_pose_version++;
 	mtx.unlock();
 	return true;
 }
@@ -795,68 +728,186 @@ bool save_geom_quat(const char *path)
 /* Fix bug for m->geom_quat ends */
 /*********************************/
 
+static std::string print_XML(const tinyxml2::XMLDocument &doc)
+{
+	tinyxml2::XMLPrinter printer;
+	doc.Print(&printer);
+	return printer.CStr();
+}
+
+/**
+ * @brief Replace a file in vfs
+ *
+ * @param file_name Name of the file, as referenced by the model files
+ * @param content Content of the file
+ * @return true if succeed
+ */
+static bool put_vfs_file(const std::string &file_name, const std::string &content)
+{
+	if (vfs == nullptr)
+	{
+		vfs = (mjVFS *)mju_malloc(sizeof(mjVFS));
+		mj_defaultVFS(vfs);
+	}
+
+	mj_deleteFileVFS(vfs, file_name.c_str());
+	if (mj_makeEmptyFileVFS(vfs, file_name.c_str(), content.size()) != 0)
+	{
+		ROS_WARN("Failed to add file %s to the virtual file system", file_name.c_str());
+		return false;
+	}
+	memcpy(vfs->filedata[mj_findFileVFS(vfs, file_name.c_str())], content.data(), content.size());
+	return true;
+}
+
+/**
+ * @brief Put the model files of the current model into vfs, must be called whenever cache_model_doc changes
+ *
+ * @return true if succeed
+ */
+static bool put_model_files()
+{
+	return put_vfs_file(cache_model_path.filename().string(), print_XML(cache_model_doc));
+}
+
+/**
+ * @brief Compile tmp_model_doc from vfs, xml_mtx must be locked by the caller
+ *
+ * @param model The compiled model
+ * @return true if succeed
+ */
+static bool compile_tmp_model(mjModel *&model)
+{
+	if (!put_vfs_file(tmp_model_name, print_XML(tmp_model_doc)))
+	{
+		return false;
+	}
+
+	char error[1000] = "Could not load model";
+	model = mj_loadXML(tmp_model_name.c_str(), vfs, error, 1000);
+	if (model == nullptr)
+	{
+		ROS_WARN("Could not compile model %s: %s", tmp_model_name.c_str(), error);
+		return false;
+	}
+	model_from_xml = true;
+	return true;
+}
+
 /**
- * @brief Load the tmp_model_path
+ * @brief Compile tmp_model_doc, xml_mtx must be locked by the caller
  *
  * @param reset Reset the simulation or not
+ * @param add_xml_doc Elements which have just been added to tmp_model_doc
  * @return true if succeed
  */
-bool load_tmp_model(bool reset)
+bool load_tmp_model(bool reset, tinyxml2::XMLDocument *add_xml_doc = nullptr)
 {
 	if (reset)
 	{
 		// load and compile model
-		if (!load_XML(m, tmp_model_path.c_str()))
+		if (!compile_tmp_model(m))
 		{
-			ROS_WARN("Could not load model file '%s'", tmp_model_path.c_str());
 			return false;
 		}
+		MjNameRegistry::get_instance().bind(m);
 
 		// make data
 		d = mj_makeData(m);
 		init_malloc();
+		model_version++;
+		MjSpawnPool::get_instance().bind();
 
 		MjSim::geom_pose.clear();
-		return save_geom_quat(cache_model_path.c_str()) && save_geom_quat(tmp_model_path.c_str());
+		return save_geom_quat(cache_model_doc) && save_geom_quat(tmp_model_doc);
 	}
 	else
 	{
-		mtx.lock();
-		// Load current.xml
+		// Compile current.xml, the old model keeps stepping while compiling
 		mjModel *m_new;
-		if (!load_XML(m_new, tmp_model_path.c_str()))
+		if (!compile_tmp_model(m_new))
 		{
-			ROS_WARN("Could not load model file '%s'", tmp_model_path.c_str());
-			mtx.unlock();
 			return false;
 		}
+		MjNameRegistry::get_instance().bind(m_new);
 
 		// make data
 		mjData *d_new = mj_makeData(m_new);
-		add_old_state(m_new, d_new);
-		init_malloc();
 
-		mtx.unlock();
+		// Map the states while the old model keeps stepping
+		const MjStateMigration mj_state_migration(m, m_new);
 
+		// Swap the models, the old state is copied here to keep the steps taken while compiling
+		mtx.lock();
+		mjModel *m_old = m;
+		mjData *d_old = d;
+		mj_state_migration.apply(d, d_new);
+		d = d_new;
+		m = m_new;
+		init_malloc();
+		model_version++;
+		MjSpawnPool::get_instance().bind();
 		MjSim::geom_pose.clear();
+		mtx.unlock();
+
+		retire_model(m_old, d_old);
 
-		return save_geom_quat((tmp_model_path.parent_path() / "add.xml").c_str()) && save_geom_quat(tmp_model_path.c_str());
+		return (add_xml_doc == nullptr || save_geom_quat(*add_xml_doc)) && save_geom_quat(cache_model_doc) && save_geom_quat(tmp_model_doc);
 	}
 }
 
+/**
+ * @brief Use the model of the model cache, tmp_model_doc and cache_model_doc have been parsed from the cache
+ *
+ * @param m_cached The cached model
+ */
+static void load_cached_model(mjModel *m_cached)
+{
+	m = m_cached;
+	MjNameRegistry::get_instance().bind(m);
+	d = mj_makeData(m);
+	init_malloc();
+	model_version++;
+	MjSpawnPool::get_instance().bind();
+	model_from_xml = false;
+}
+
+/**
+ * @brief Collect the names of all bodies in tmp_model_doc and cache_model_doc, including the world body
+ */
+static std::vector<std::string> get_body_names()
+{
+	std::vector<std::string> body_names = {"world"};
+	for (tinyxml2::XMLDocument *xml_doc : {&tmp_model_doc, &cache_model_doc})
+	{
+		if (xml_doc->FirstChildElement() == nullptr)
+		{
+			continue;
+		}
+		do_each_child_element(xml_doc->FirstChildElement(), "worldbody", [&body_names](tinyxml2::XMLElement *worldbody_element)
+							  { do_each_child_element(worldbody_element, [&body_names](tinyxml2::XMLElement *body_element)
+													  {
+														if (body_element->Attribute("name") != nullptr)
+														{
+															body_names.push_back(body_element->Attribute("name"));
+														} }); });
+	}
+	return body_names;
+}
+
+/**
+ * @brief Add a mocap reference body welded to every received body of tmp_model_doc, before the model is compiled
+ */
 static void init_references()
 {
 	XmlRpc::XmlRpcValue receive_params;
 	if (ros::param::get("~receive", receive_params))
 	{
-		tinyxml2::XMLDocument xml_doc;
-		if (!load_XML(xml_doc, tmp_model_path.c_str()))
-		{
-			ROS_WARN("Failed to load file \"%s\"\n", tmp_model_path.c_str());
-			return;
-		}
+		tinyxml2::XMLDocument &xml_doc = tmp_model_doc;
+
+		const std::vector<std::string> body_names = get_body_names();
+		const std::set<std::string> body_name_set(body_names.begin(), body_names.end());
 
-		mtx.lock();
 		tinyxml2::XMLElement *mujoco_element = xml_doc.FirstChildElement();
 
 		tinyxml2::XMLElement *equality_element = xml_doc.NewElement("equality");
@@ -874,12 +925,9 @@ static void init_references()
 			const std::string body_name = receive_param.first;
 			const std::string ref_body_name = receive_param.first + "_ref";
 			
-			const int body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, body_name.c_str());
-			const int ref_body_id = mj_name2id(m, mjtObj::mjOBJ_BODY, ref_body_name.c_str());
-			
-			if (body_id != -1 && ref_body_id == -1)
+			if (body_name_set.count(body_name) != 0 && body_name_set.count(ref_body_name) == 0)
 			{
-				tinyxml2::XMLElement *ref_body_element;
+				tinyxml2::XMLElement *ref_body_element = nullptr;
 				do_each_child_element(mujoco_element, "worldbody", [&xml_doc, &ref_body_element, body_name](tinyxml2::XMLElement *worldbody_element)
 									  {
 										for (tinyxml2::XMLElement *body_element = worldbody_element->FirstChildElement("body");
@@ -897,6 +945,11 @@ static void init_references()
 												ref_body_element = body_element->DeepClone(&xml_doc)->ToElement();
 											} 
 										}; });
+				if (ref_body_element == nullptr)
+				{
+					ROS_WARN("Body %s is not a body of the world, ignore...", body_name.c_str());
+					continue;
+				}
 										
 				ref_body_element->SetAttribute("name", ref_body_name.c_str());
 
@@ -937,128 +990,173 @@ static void init_references()
 				weld_element->SetAttribute("body2", ref_body_name.c_str());
 				weld_element->SetAttribute("torquescale", 0.9);
 
-				for (int each_body_id = 0; each_body_id < m->nbody; each_body_id++)
+				for (const std::string &each_body_name : body_names)
 				{		
 					tinyxml2::XMLElement *exclude_element = xml_doc.NewElement("exclude");
 					contact_element->LinkEndChild(exclude_element);
 
-					exclude_element->SetAttribute("body1", mj_id2name(m, mjtObj::mjOBJ_BODY, each_body_id));
+					exclude_element->SetAttribute("body1", each_body_name.c_str());
 					exclude_element->SetAttribute("body2", ref_body_name.c_str());	
 				}
 			}
 		}
-
-		if (!save_XML(xml_doc, tmp_model_path.c_str()))
-		{
-			ROS_WARN("Failed to save file \"%s\"\n", tmp_model_path.c_str());
-		}
-
-		mtx.unlock();
-
-		load_tmp_model(true);
 	}
 }
 
-void MjSim::init()
+const tinyxml2::XMLDocument *MjSim::get_model_doc()
 {
-	init_tmp();
-	load_tmp_model(true);
-	ROS_INFO("Reload model in %s complete", model_path.c_str());
-	set_joint_names();
-	init_sensors();
-	init_references();
-	sim_start = d->time;
+	if (model_doc.FirstChildElement() == nullptr && !load_XML(model_doc, model_path.c_str()))
+	{
+		ROS_WARN("Failed to load file \"%s\"\n", model_path.c_str());
+		return nullptr;
+	}
+	return &model_doc;
 }
 
-void MjSim::init_sensors()
+void MjSim::init()
 {
-	for (int sensor_id = 0; sensor_id < m->nsensor; sensor_id++)
+	for (const std::string &robot : MjSim::robot_names)
 	{
-		std::string sensor_name;
-		if (m->sensor_type[sensor_id] == mjtSensor::mjSENS_FORCE)
+		MjOdomPlan &odom_plan = MjSim::odom_plans[robot];
+		for (size_t i = 0; i < MjSim::odom_joint_names.size(); i++)
 		{
-			if (mj_id2name(m, mjtObj::mjOBJ_SENSOR, sensor_id) == nullptr)
-			{
-				ROS_WARN("Sensor with id %d doesn't have a name, create one...", sensor_id);
-				sensor_name = "force_sensor_";
-				sensor_name += mj_id2name(m, mjtObj::mjOBJ_SITE, m->sensor_objid[sensor_id]);
-				ROS_WARN("Created sensor %s", sensor_name.c_str());
-			}
-			else
+			odom_plan.cmd_vels[i] = 0.0;
+			if (MjSim::add_odom_joints[robot][MjSim::odom_joint_names[i]])
 			{
-				sensor_name = mj_id2name(m, mjtObj::mjOBJ_SENSOR, sensor_id);
+				odom_plan.enabled |= 1u << i;
 			}
 		}
-		else if (m->sensor_type[sensor_id] == mjtSensor::mjSENS_TORQUE)
+	}
+
+	std::lock_guard<std::mutex> xml_lock(xml_mtx);
+	MjModelCache &mj_model_cache = MjModelCache::get_instance();
+	mj_model_cache.init();
+	init_tmp_paths();
+	std::string tmp_model_xml, cache_model_xml;
+	mjModel *m_cached = mj_model_cache.load(tmp_model_xml, cache_model_xml);
+	if (m_cached != nullptr &&
+		tmp_model_doc.Parse(tmp_model_xml.c_str()) == tinyxml2::XML_SUCCESS &&
+		cache_model_doc.Parse(cache_model_xml.c_str()) == tinyxml2::XML_SUCCESS &&
+		put_model_files())
+	{
+		load_cached_model(m_cached);
+		init_sensors();
+	}
+	else
+	{
+		if (m_cached != nullptr)
 		{
-			if (mj_id2name(m, mjtObj::mjOBJ_SENSOR, sensor_id) == nullptr)
-			{
-				ROS_WARN("Sensor with id %d doesn't have a name, create one...", sensor_id);
-				sensor_name = "torque_sensor_";
-				sensor_name += mj_id2name(m, mjtObj::mjOBJ_SITE, m->sensor_objid[sensor_id]);
-				ROS_WARN("Created sensor %s", sensor_name.c_str());
-			}
-			else
-			{
-				sensor_name = mj_id2name(m, mjtObj::mjOBJ_SENSOR, sensor_id);
-			}
+			mj_deleteModel(m_cached);
 		}
-		else
+		// Every pass runs on the parsed documents, the model is compiled once
+		if (!init_tmp() || !put_model_files())
 		{
-			ROS_WARN("Sensor with type_id %d not implemented, ignore...", m->sensor_type[sensor_id]);
-			continue;
+			ROS_WARN("Failed to load the model files in %s", tmp_model_path.parent_path().c_str());
 		}
-
-		sensors[sensor_id] = sensor_name;
+		set_joint_names();
+		init_references();
+		load_tmp_model(true);
+		ROS_INFO("Reload model in %s complete", model_path.c_str());
+		init_sensors();
+		mj_model_cache.save(print_XML(tmp_model_doc), print_XML(cache_model_doc));
 	}
+	model_doc.Clear();
+	sim_start = d->time;
 }
 
-bool MjSim::add_data()
+void MjSim::init_sensors()
 {
-	// Save current.xml
-	save_XML(m, tmp_model_path.c_str());
+	for (int sensor_id = 0; sensor_id < m->nsensor; sensor_id++)
+	{
+		const std::string sensor_name = get_sensor_name(sensor_id);
+		if (mj_id2name(m, mjtObj::mjOBJ_SENSOR, sensor_id) == nullptr)
+		{
+			ROS_WARN("Sensor with id %d doesn't have a name, created %s", sensor_id, sensor_name.c_str());
+		}
 
-	modify_xml(tmp_model_path.c_str());
+		sensors[sensor_id] = sensor_name;
+	}
+}
 
-	// Add add.xml to current.xml
-	tinyxml2::XMLDocument current_xml_doc;
-	if (!load_XML(current_xml_doc, tmp_model_path.c_str()))
+std::string MjSim::get_sensor_name(const int sensor_id, const mjModel *model)
+{
+	if (mj_id2name(model, mjtObj::mjOBJ_SENSOR, sensor_id) != nullptr)
 	{
-		ROS_WARN("Failed to load file \"%s\"\n", tmp_model_path.c_str());
-		return false;
+		return mj_id2name(model, mjtObj::mjOBJ_SENSOR, sensor_id);
 	}
 
-	tinyxml2::XMLElement *current_element = current_xml_doc.FirstChildElement();
-	tinyxml2::XMLElement *include_element = current_xml_doc.NewElement("include");
-	include_element->SetAttribute("file", "add.xml");
-	current_element->LinkEndChild(include_element);
-	if (!save_XML(current_xml_doc, tmp_model_path.c_str()))
+	// Force and torque sensors are named after their site, the other types may share an object
+	const char *object_name = mj_id2name(model, model->sensor_objtype[sensor_id], model->sensor_objid[sensor_id]);
+	if (model->sensor_type[sensor_id] == mjtSensor::mjSENS_FORCE && object_name != nullptr)
 	{
-		ROS_WARN("Failed to save file \"%s\"\n", tmp_model_path.c_str());
-		return false;
+		return std::string("force_sensor_") + object_name;
 	}
+	if (model->sensor_type[sensor_id] == mjtSensor::mjSENS_TORQUE && object_name != nullptr)
+	{
+		return std::string("torque_sensor_") + object_name;
+	}
+	return "sensor_" + std::to_string(sensor_id);
+}
 
-	return load_tmp_model(false);
+bool MjSim::add_data(tinyxml2::XMLDocument &add_xml_doc)
+{
+	return edit_data(&add_xml_doc, {});
 }
 
 bool MjSim::remove_body(const std::set<std::string> &body_names)
 {
-	// Save current.xml
-	save_XML(m, tmp_model_path.c_str());
+	return edit_data(nullptr, body_names);
+}
+
+bool MjSim::edit_data(tinyxml2::XMLDocument *add_xml_doc, const std::set<std::string> &remove_body_names)
+{
+	std::lock_guard<std::mutex> xml_lock(xml_mtx);
+	const std::string tmp_model_xml = print_XML(tmp_model_doc);
 
 	// Modify current.xml
-	modify_xml(tmp_model_path.c_str(), body_names);
+	modify_xml(tmp_model_doc, remove_body_names);
 
-	return load_tmp_model(false);
+	// Add add.xml to current.xml
+	if (add_xml_doc != nullptr)
+	{
+		tinyxml2::XMLElement *current_element = tmp_model_doc.FirstChildElement();
+		for (const tinyxml2::XMLNode *node = add_xml_doc->FirstChildElement()->FirstChild();
+			 node != nullptr;
+			 node = node->NextSibling())
+		{
+			current_element->InsertEndChild(node->DeepClone(&tmp_model_doc));
+		}
+	}
+
+	if (!load_tmp_model(false, add_xml_doc))
+	{
+		// Drop the edits which failed to compile
+		tmp_model_doc.Parse(tmp_model_xml.c_str());
+		return false;
+	}
+	return true;
 }
 
 void MjSim::controller()
 {
+	if (controlled_dof_ids_model_version != model_version || controlled_dof_ids_joints_version != controlled_joints_version)
+	{
+		controlled_dof_ids.clear();
+		for (const std::string &joint_name : MjSim::controlled_joints)
+		{
+			const int joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, joint_name);
+			if (joint_id != -1)
+			{
+				controlled_dof_ids.push_back(m->jnt_dofadr[joint_id]);
+			}
+		}
+		controlled_dof_ids_model_version = model_version;
+		controlled_dof_ids_joints_version = controlled_joints_version;
+	}
+
 	mj_mulM(m, d, tau, ddq);
-	for (const std::string &joint_name : MjSim::controlled_joints)
+	for (const int dof_id : controlled_dof_ids)
 	{
-		const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-		const int dof_id = m->jnt_dofadr[joint_id];
 		tau[dof_id] += d->qfrc_bias[dof_id];
 	}
 
@@ -1076,79 +1174,187 @@ void MjSim::controller()
 	mju_zero(dq, m->nv);
 }
 
+/**
+ * @brief Resolve the odom joints of every robot in the current model
+ */
+static void bind_odom_plans()
+{
+	for (std::pair<const std::string, MjOdomPlan> &odom_plan : MjSim::odom_plans)
+	{
+		for (size_t i = 0; i < MjSim::odom_joint_names.size(); i++)
+		{
+			const int joint_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_JOINT, odom_plan.first + "_" + MjSim::odom_joint_names[i]);
+			odom_plan.second.qpos_ids[i] = joint_id != -1 ? m->jnt_qposadr[joint_id] : -1;
+			odom_plan.second.dof_ids[i] = joint_id != -1 ? m->jnt_dofadr[joint_id] : -1;
+		}
+	}
+	odom_plans_model_version = model_version;
+}
+
 void MjSim::set_odom_vels()
 {
-	for (const std::string &robot : MjSim::robot_names)
+	if (odom_plans_model_version != model_version)
 	{
-		const int odom_x_joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, (robot + "_ang_odom_x_joint").c_str());
-		const int odom_y_joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, (robot + "_ang_odom_y_joint").c_str());
-		const int odom_z_joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, (robot + "_ang_odom_z_joint").c_str());
-		const int odom_x_qpos_id = m->jnt_qposadr[odom_x_joint_id];
-		const int odom_y_qpos_id = m->jnt_qposadr[odom_y_joint_id];
-		const int odom_z_qpos_id = m->jnt_qposadr[odom_z_joint_id];
-		mjtNum odom_x_joint_pos = odom_x_joint_id != -1 ? d->qpos[odom_x_qpos_id] : 0.f;
-		mjtNum odom_y_joint_pos = odom_y_joint_id != -1 ? d->qpos[odom_y_qpos_id] : 0.f;
-		mjtNum odom_z_joint_pos = odom_z_joint_id != -1 ? d->qpos[odom_z_qpos_id] : 0.f;
-
-		if (MjSim::add_odom_joints[robot]["lin_odom_x_joint"])
+		bind_odom_plans();
+	}
+
+	for (const std::pair<const std::string, MjOdomPlan> &odom_plan : MjSim::odom_plans)
+	{
+		const MjOdomPlan &plan = odom_plan.second;
+		if (plan.enabled == 0)
 		{
-			const std::string joint_name = robot + "_lin_odom_x_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
-			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = MjSim::odom_vels[robot + "_lin_odom_x_joint"] * mju_cos(odom_y_joint_pos) * mju_cos(odom_z_joint_pos) + MjSim::odom_vels[robot + "_lin_odom_y_joint"] * (mju_sin(odom_x_joint_pos) * mju_sin(odom_y_joint_pos) * mju_cos(odom_z_joint_pos) - mju_cos(odom_x_joint_pos) * mju_sin(odom_z_joint_pos)) + MjSim::odom_vels[robot + "_lin_odom_z_joint"] * (mju_cos(odom_x_joint_pos) * mju_sin(odom_y_joint_pos) * mju_cos(odom_z_joint_pos) + mju_sin(odom_x_joint_pos) * mju_sin(odom_z_joint_pos));
-			}
+			continue;
 		}
-		if (MjSim::add_odom_joints[robot]["lin_odom_y_joint"])
+
+		const mjtNum odom_x_joint_pos = plan.qpos_ids[3] != -1 ? d->qpos[plan.qpos_ids[3]] : 0.f;
+		const mjtNum odom_y_joint_pos = plan.qpos_ids[4] != -1 ? d->qpos[plan.qpos_ids[4]] : 0.f;
+		const mjtNum odom_z_joint_pos = plan.qpos_ids[5] != -1 ? d->qpos[plan.qpos_ids[5]] : 0.f;
+		const mjtNum cos_x = mju_cos(odom_x_joint_pos);
+		const mjtNum sin_x = mju_sin(odom_x_joint_pos);
+		const mjtNum cos_y = mju_cos(odom_y_joint_pos);
+		const mjtNum sin_y = mju_sin(odom_y_joint_pos);
+		const mjtNum cos_z = mju_cos(odom_z_joint_pos);
+		const mjtNum sin_z = mju_sin(odom_z_joint_pos);
+
+		mjtNum cmd_vels[6];
+		for (int i = 0; i < 6; i++)
 		{
-			const std::string joint_name = robot + "_lin_odom_y_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
-			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = MjSim::odom_vels[robot + "_lin_odom_x_joint"] * mju_cos(odom_y_joint_pos) * mju_sin(odom_z_joint_pos) + MjSim::odom_vels[robot + "_lin_odom_y_joint"] * (mju_sin(odom_x_joint_pos) * mju_sin(odom_y_joint_pos) * mju_sin(odom_z_joint_pos) + mju_cos(odom_x_joint_pos) * mju_cos(odom_z_joint_pos)) + MjSim::odom_vels[robot + "_lin_odom_z_joint"] * (mju_cos(odom_x_joint_pos) * mju_sin(odom_y_joint_pos) * mju_sin(odom_z_joint_pos) - mju_sin(odom_x_joint_pos) * mju_cos(odom_z_joint_pos));
-			}
+			cmd_vels[i] = plan.cmd_vels[i].load(std::memory_order_relaxed);
 		}
-		if (MjSim::add_odom_joints[robot]["lin_odom_z_joint"])
+
+		mjtNum vels[6];
+		vels[0] = cmd_vels[0] * cos_y * cos_z + cmd_vels[1] * (sin_x * sin_y * cos_z - cos_x * sin_z) + cmd_vels[2] * (cos_x * sin_y * cos_z + sin_x * sin_z);
+		vels[1] = cmd_vels[0] * cos_y * sin_z + cmd_vels[1] * (sin_x * sin_y * sin_z + cos_x * cos_z) + cmd_vels[2] * (cos_x * sin_y * sin_z - sin_x * cos_z);
+		vels[2] = -cmd_vels[0] * sin_y + cmd_vels[1] * sin_x * cos_y + cmd_vels[2] * cos_x * cos_y;
+		vels[3] = cmd_vels[3];
+		vels[4] = cmd_vels[4];
+		vels[5] = cmd_vels[5];
+
+		for (int i = 0; i < 6; i++)
 		{
-			const std::string joint_name = robot + "_lin_odom_z_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
+			if ((plan.enabled & (1u << i)) && plan.dof_ids[i] != -1)
 			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = -MjSim::odom_vels[robot + "_lin_odom_x_joint"] * mju_sin(odom_y_joint_pos) + MjSim::odom_vels[robot + "_lin_odom_y_joint"] * mju_sin(odom_x_joint_pos) * mju_cos(odom_y_joint_pos) + MjSim::odom_vels[robot + "_lin_odom_z_joint"] * mju_cos(odom_x_joint_pos) * mju_cos(odom_y_joint_pos);
+				d->qvel[plan.dof_ids[i]] = vels[i];
 			}
 		}
-		if (MjSim::add_odom_joints[robot]["ang_odom_x_joint"])
+	}
+}
+
+void MjSim::compute_efforts()
+{
+	switch (effort_source)
+	{
+	case EEffortSource::InverseDynamics:
+		mj_inverse(m, d);
+		mju_copy(efforts, d->qfrc_inverse, m->nv);
+		break;
+
+	case EEffortSource::ActuatorForce:
+		mju_add(efforts, d->qfrc_actuator, d->qfrc_applied, m->nv);
+		break;
+
+	case EEffortSource::JointTorqueSensor:
+		// Only actuatorfrc sensors of joint actuators contribute, the other dofs report zero
+		mju_zero(efforts, m->nv);
+		for (int sensor_id = 0; sensor_id < m->nsensor; sensor_id++)
 		{
-			const std::string joint_name = robot + "_ang_odom_x_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
+			if (m->sensor_type[sensor_id] != mjtSensor::mjSENS_ACTUATORFRC)
 			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = MjSim::odom_vels[robot + "_ang_odom_x_joint"];
+				continue;
 			}
-		}
-		if (MjSim::add_odom_joints[robot]["ang_odom_y_joint"])
-		{
-			const std::string joint_name = robot + "_ang_odom_y_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
+			const int actuator_id = m->sensor_objid[sensor_id];
+			if (m->actuator_trntype[actuator_id] != mjtTrn::mjTRN_JOINT)
 			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = MjSim::odom_vels[robot + "_ang_odom_y_joint"];
+				continue;
 			}
+			const int joint_id = m->actuator_trnid[2 * actuator_id];
+			// The sensor measures the force in actuator space, the gear maps it to the joint
+			efforts[m->jnt_dofadr[joint_id]] += m->actuator_gear[6 * actuator_id] * d->sensordata[m->sensor_adr[sensor_id]];
 		}
-		if (MjSim::add_odom_joints[robot]["ang_odom_z_joint"])
+		break;
+	}
+}
+
+void MjSim::request_steps(const unsigned int step_num)
+{
+	{
+		std::lock_guard<std::mutex> step_lock(step_mtx);
+		requested_step_num += step_num;
+	}
+	step_cv.notify_one();
+}
+
+bool MjSim::wait_for_step()
+{
+	std::unique_lock<std::mutex> step_lock(step_mtx);
+	// Return regularly to let the caller check ros::ok() and free retired models
+	if (!step_cv.wait_for(step_lock, std::chrono::milliseconds(100), []
+						  { return requested_step_num > 0; }))
+	{
+		return false;
+	}
+	requested_step_num--;
+	return true;
+}
+
+void MjSim::add_stall_time(const std::chrono::nanoseconds stall_time)
+{
+	const unsigned long long stall_time_ns = stall_time.count();
+	MjSim::stall_time += stall_time_ns;
+	unsigned long long max_stall_time_ns = max_stall_time.load(std::memory_order_relaxed);
+	while (stall_time_ns > max_stall_time_ns && !max_stall_time.compare_exchange_weak(max_stall_time_ns, stall_time_ns, std::memory_order_relaxed))
+	{
+	}
+	step_count++;
+}
+
+bool MjSim::stage_file(const boost::filesystem::path &file_path, const boost::filesystem::path &staged_file_path, const EMeshStaging mesh_staging)
+{
+	if (boost::filesystem::exists(boost::filesystem::symlink_status(staged_file_path)))
+	{
+		return true;
+	}
+
+	boost::system::error_code error_code;
+	switch (mesh_staging)
+	{
+	case EMeshStaging::Symlink:
+		boost::filesystem::create_symlink(boost::filesystem::absolute(file_path), staged_file_path, error_code);
+		break;
+
+	case EMeshStaging::Hardlink:
+		boost::filesystem::create_hard_link(file_path, staged_file_path, error_code);
+		break;
+
+	default:
+		error_code = boost::system::errc::make_error_code(boost::system::errc::not_supported);
+		break;
+	}
+
+	if (error_code)
+	{
+		boost::filesystem::copy_file(file_path, staged_file_path, error_code);
+	}
+	if (error_code)
+	{
+		ROS_WARN("Failed to stage %s in %s: %s", file_path.c_str(), staged_file_path.c_str(), error_code.message().c_str());
+		return false;
+	}
+	return true;
+}
+
+bool MjSim::save_model_xml(const char *path)
+{
+	std::lock_guard<std::mutex> xml_lock(xml_mtx);
+	if (!model_from_xml)
+	{
+		// Compile current.xml once, mj_saveLastXML writes the last model compiled from xml
+		mjModel *m_xml;
+		if (!compile_tmp_model(m_xml))
 		{
-			const std::string joint_name = robot + "_ang_odom_z_joint";
-			const int joint_id = mj_name2id(m, mjtObj::mjOBJ_JOINT, joint_name.c_str());
-			if (joint_id != -1)
-			{
-				const int dof_id = m->jnt_dofadr[joint_id];
-				d->qvel[dof_id] = MjSim::odom_vels[robot + "_ang_odom_z_joint"];
-			}
+			return false;
 		}
+		mj_deleteModel(m_xml);
 	}
-}
\ No newline at end of file
+	return save_XML(m, path);
+}
@@ -0,0 +1,157 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mj_snapshot.h"
+#include "mj_sim.h"
+
+#include <cstring>
+
+/**
+ * @brief Get the size of the exported state of a model
+ *
+ */
+static size_t get_snapshot_size(const mjModel *model)
+{
+    return 7 * model->nbody + model->nq + 2 * model->nv + model->nsensordata + 12 * model->ngeom;
+}
+
+/**
+ * @brief Copy the exported fields of d into one contiguous array
+ *
+ */
+static void pack(mjtNum *data)
+{
+    mju_copy(data, d->xpos, 3 * m->nbody);
+    data += 3 * m->nbody;
+    mju_copy(data, d->xquat, 4 * m->nbody);
+    data += 4 * m->nbody;
+    mju_copy(data, d->qpos, m->nq);
+    data += m->nq;
+    mju_copy(data, d->qvel, m->nv);
+    data += m->nv;
+    mju_copy(data, MjSim::efforts, m->nv);
+    data += m->nv;
+    mju_copy(data, d->sensordata, m->nsensordata);
+    data += m->nsensordata;
+    mju_copy(data, d->geom_xpos, 3 * m->ngeom);
+    data += 3 * m->ngeom;
+    mju_copy(data, d->geom_xmat, 9 * m->ngeom);
+}
+
+/**
+ * @brief Point the views of the snapshot into its data
+ *
+ */
+static void unpack(MjSnapshot &snapshot)
+{
+    const mjModel *model = snapshot.model;
+    const mjtNum *data = snapshot.data.data();
+    snapshot.xpos = data;
+    data += 3 * model->nbody;
+    snapshot.xquat = data;
+    data += 4 * model->nbody;
+    snapshot.qpos = data;
+    data += model->nq;
+    snapshot.qvel = data;
+    data += model->nv;
+    snapshot.efforts = data;
+    data += model->nv;
+    snapshot.sensordata = data;
+    data += model->nsensordata;
+    snapshot.geom_xpos = data;
+    data += 3 * model->ngeom;
+    snapshot.geom_xmat = data;
+}
+
+void MjSnapshotBuffer::write()
+{
+    Buffers *current_buffers = buffers.load(std::memory_order_relaxed);
+    if (current_buffers == nullptr || current_buffers->model_version != model_version)
+    {
+        // The model has been replaced, readers may still copy from the old buffers
+        Buffers *new_buffers = new Buffers();
+        new_buffers->model = m;
+        new_buffers->model_version = model_version;
+        for (Slot &slot : new_buffers->slots)
+        {
+            slot.data.resize(get_snapshot_size(m));
+        }
+        buffers.store(new_buffers, std::memory_order_release);
+        if (current_buffers != nullptr)
+        {
+            retire([current_buffers]()
+                   { delete current_buffers; });
+        }
+        current_buffers = new_buffers;
+    }
+
+    const int slot_id = (current_buffers->latest.load(std::memory_order_relaxed) + 1) % 3;
+    Slot &slot = current_buffers->slots[slot_id];
+
+    const unsigned int seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.time = d->time;
+    pack(slot.data.data());
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    current_buffers->latest.store(slot_id, std::memory_order_release);
+}
+
+bool MjSnapshotBuffer::read(MjSnapshot &snapshot) const
+{
+    const Buffers *current_buffers = buffers.load(std::memory_order_acquire);
+    if (current_buffers == nullptr || current_buffers->model_version != model_version)
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        const int slot_id = current_buffers->latest.load(std::memory_order_acquire);
+        if (slot_id == -1)
+        {
+            return false;
+        }
+
+        const Slot &slot = current_buffers->slots[slot_id];
+        const unsigned int seq = slot.seq.load(std::memory_order_acquire);
+        if (seq % 2 == 1)
+        {
+            continue;
+        }
+
+        snapshot.data.resize(slot.data.size());
+        std::memcpy(snapshot.data.data(), slot.data.data(), slot.data.size() * sizeof(mjtNum));
+        snapshot.time = slot.time;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq)
+        {
+            break;
+        }
+    }
+
+    snapshot.model = current_buffers->model;
+    snapshot.model_version = current_buffers->model_version;
+    unpack(snapshot);
+    return true;
+}
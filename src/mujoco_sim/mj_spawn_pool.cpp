@@ -0,0 +1,773 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mj_spawn_pool.h"
+
+#include "mj_name_registry.h"
+#include "mj_util.h"
+
+// Free slots wait here, far away from everything else
+static const mjtNum park_pos[3] = {0.0, 0.0, -100.0};
+
+static geometry_msgs::Pose get_park_pose()
+{
+    geometry_msgs::Pose park_pose;
+    park_pose.position.x = park_pos[0];
+    park_pose.position.y = park_pos[1];
+    park_pose.position.z = park_pos[2];
+    park_pose.orientation.w = 1.0;
+    return park_pose;
+}
+
+// Default geom density of MuJoCo
+static const mjtNum density = 1000.0;
+
+static const std::vector<std::pair<int, std::string>> primitive_types = {
+    {mujoco_msgs::ObjectInfo::CUBE, "box"},
+    {mujoco_msgs::ObjectInfo::SPHERE, "sphere"},
+    {mujoco_msgs::ObjectInfo::CYLINDER, "cylinder"}};
+
+static bool is_zero(const geometry_msgs::Vector3 &vec)
+{
+    return mju_abs(vec.x) < mjMINVAL && mju_abs(vec.y) < mjMINVAL && mju_abs(vec.z) < mjMINVAL;
+}
+
+static bool is_zero(const std_msgs::ColorRGBA &rgba)
+{
+    return mju_abs(rgba.r) < mjMINVAL && mju_abs(rgba.g) < mjMINVAL && mju_abs(rgba.b) < mjMINVAL && mju_abs(rgba.a) < mjMINVAL;
+}
+
+static bool is_scaled(const mujoco_msgs::ObjectInfo &info)
+{
+    return !is_zero(info.size) &&
+           (mju_abs(info.size.x - 1) > mjMINVAL || mju_abs(info.size.y - 1) > mjMINVAL || mju_abs(info.size.z - 1) > mjMINVAL);
+}
+
+static int get_jnt_qpos_num(const int joint_id)
+{
+    switch (m->jnt_type[joint_id])
+    {
+    case mjtJoint::mjJNT_FREE:
+        return 7;
+
+    case mjtJoint::mjJNT_BALL:
+        return 4;
+
+    default:
+        return 1;
+    }
+}
+
+static int get_jnt_dof_num(const int joint_id)
+{
+    switch (m->jnt_type[joint_id])
+    {
+    case mjtJoint::mjJNT_FREE:
+        return 6;
+
+    case mjtJoint::mjJNT_BALL:
+        return 3;
+
+    default:
+        return 1;
+    }
+}
+
+void MjSpawnPool::init()
+{
+    if (!ros::param::get("~spawn_pool/free_slots", free_slot_num))
+    {
+        free_slot_num = 0;
+    }
+    if (!ros::param::get("~spawn_pool/mocap_slots", mocap_slot_num))
+    {
+        mocap_slot_num = 0;
+    }
+    if (!ros::param::get("~spawn_pool/template_slots", template_slot_num))
+    {
+        template_slot_num = 0;
+    }
+    std::vector<std::string> template_paths;
+    if (!ros::param::get("~spawn_pool/templates", template_paths))
+    {
+        template_paths.clear();
+    }
+
+    slots.clear();
+    slot_ids.clear();
+    for (const std::pair<int, std::string> &primitive_type : primitive_types)
+    {
+        for (const bool movable : {true, false})
+        {
+            const int slot_num = movable ? free_slot_num : mocap_slot_num;
+            for (int i = 0; i < slot_num; i++)
+            {
+                MjPoolSlot slot;
+                slot.slot_name = "spawn_pool_" + primitive_type.second + (movable ? "_free_" : "_mocap_") + std::to_string(i);
+                slot.key = primitive_type.second;
+                slot.movable = movable;
+                slot.info.type = primitive_type.first;
+                slot_ids[slot.slot_name] = slots.size();
+                slots.push_back(slot);
+            }
+        }
+    }
+
+    templates.clear();
+    for (const std::string &template_path_string : template_paths)
+    {
+        mujoco_msgs::ObjectInfo info;
+        info.type = mujoco_msgs::ObjectInfo::MESH;
+        info.mesh = template_path_string;
+        const std::string key = get_key(info);
+        if (key.empty())
+        {
+            ROS_WARN("Template [%s] is not a MJCF file, ignore...", template_path_string.c_str());
+            continue;
+        }
+
+        for (int i = 0; i < template_slot_num; i++)
+        {
+            MjPoolSlot slot;
+            slot.slot_name = "spawn_pool_" + boost::filesystem::path(key).stem().string() + "_" + std::to_string(templates.size()) + "_" + std::to_string(i);
+            slot.key = key;
+            slot.movable = true;
+            slot.info = info;
+            slot_ids[slot.slot_name] = slots.size();
+            slots.push_back(slot);
+        }
+        templates.push_back(key);
+    }
+
+    if (!slots.empty())
+    {
+        ROS_INFO("Set spawn pool with %ld slots", slots.size());
+    }
+}
+
+std::vector<mujoco_msgs::ObjectStatus> MjSpawnPool::get_slot_objects() const
+{
+    std::vector<mujoco_msgs::ObjectStatus> objects;
+    objects.reserve(slots.size());
+    for (const MjPoolSlot &slot : slots)
+    {
+        mujoco_msgs::ObjectStatus object;
+        object.info = slot.info;
+        object.info.name = slot.slot_name;
+        object.info.movable = slot.movable;
+        if (object.info.type != mujoco_msgs::ObjectInfo::MESH)
+        {
+            object.info.size.x = 0.05;
+            object.info.size.y = 0.05;
+            object.info.size.z = 0.05;
+            object.info.rgba.r = 0.5;
+            object.info.rgba.g = 0.5;
+            object.info.rgba.b = 0.5;
+            object.info.rgba.a = 1.0;
+        }
+        object.pose.position.x = park_pos[0];
+        object.pose.position.y = park_pos[1];
+        object.pose.position.z = park_pos[2];
+        object.pose.orientation.w = 1.0;
+        objects.push_back(object);
+    }
+    return objects;
+}
+
+void MjSpawnPool::prepare_slot_elements(tinyxml2::XMLElement *mujoco_element) const
+{
+    for (tinyxml2::XMLElement *worldbody_element = mujoco_element->FirstChildElement("worldbody");
+         worldbody_element != nullptr;
+         worldbody_element = worldbody_element->NextSiblingElement("worldbody"))
+    {
+        for (tinyxml2::XMLElement *body_element = worldbody_element->FirstChildElement("body");
+             body_element != nullptr;
+             body_element = body_element->NextSiblingElement("body"))
+        {
+            if (body_element->Attribute("name") == nullptr || !is_slot_name(body_element->Attribute("name")))
+            {
+                continue;
+            }
+
+            // Gravity compensation is decided at compile time, so all slots are compiled with it and toggled afterwards
+            body_element->SetAttribute("gravcomp", "1");
+            do_each_child_element(body_element, [](tinyxml2::XMLElement *child_body_element)
+                                  { child_body_element->SetAttribute("gravcomp", "1"); });
+        }
+    }
+}
+
+void MjSpawnPool::bind()
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    body_slot_ids.assign(m->nbody, -1);
+    if (slots.empty())
+    {
+        return;
+    }
+
+    for (size_t slot_id = 0; slot_id < slots.size(); slot_id++)
+    {
+        MjPoolSlot &slot = slots[slot_id];
+        slot.body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, slot.slot_name);
+        slot.body_ids.clear();
+        if (slot.body_id != -1)
+        {
+            body_slot_ids[slot.body_id] = slot_id;
+        }
+    }
+
+    // Slot bodies are children of the world, so their subtrees share their root
+    for (int body_id = 1; body_id < m->nbody; body_id++)
+    {
+        const int slot_id = body_slot_ids[m->body_rootid[body_id]];
+        if (slot_id != -1)
+        {
+            body_slot_ids[body_id] = slot_id;
+            slots[slot_id].body_ids.push_back(body_id);
+        }
+    }
+
+    // The freshly compiled model still has the collision filters of the xml
+    geom_collisions.clear();
+    for (const MjPoolSlot &slot : slots)
+    {
+        for (const int body_id : slot.body_ids)
+        {
+            for (int geom_id = m->body_geomadr[body_id]; geom_id < m->body_geomadr[body_id] + m->body_geomnum[body_id]; geom_id++)
+            {
+                geom_collisions[geom_id] = {m->geom_contype[geom_id], m->geom_conaffinity[geom_id]};
+            }
+        }
+    }
+
+    free_slot_ids.clear();
+    for (size_t slot_id = 0; slot_id < slots.size(); slot_id++)
+    {
+        const MjPoolSlot &slot = slots[slot_id];
+        if (slot.body_id == -1)
+        {
+            continue;
+        }
+
+        if (slot.object_name.empty())
+        {
+            deactivate(slot);
+            free_slot_ids[{slot.key, slot.movable}].push_back(slot_id);
+        }
+        else
+        {
+            activate(slot);
+        }
+    }
+}
+
+void MjSpawnPool::reset()
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    for (const MjPoolSlot &slot : slots)
+    {
+        if (slot.body_id != -1 && !slot.object_name.empty())
+        {
+            place(slot, slot.pose, geometry_msgs::Twist());
+        }
+    }
+}
+
+int MjSpawnPool::claim(const mujoco_msgs::ObjectStatus &object)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    if (slots.empty() || object_slot_ids.count(object.info.name) != 0)
+    {
+        return -1;
+    }
+
+    const std::string key = get_key(object.info);
+    if (key.empty())
+    {
+        return -1;
+    }
+
+    const bool is_template = object.info.type == mujoco_msgs::ObjectInfo::MESH;
+    if (is_template && !object.info.movable)
+    {
+        // Template slots have a free joint, a static template is compiled as mocap body instead
+        return -1;
+    }
+
+    if (is_template && is_scaled(object.info))
+    {
+        // Meshes can't be rescaled after compiling
+        return -1;
+    }
+
+    if (object.info.inertial.ixy != 0 || object.info.inertial.ixz != 0 || object.info.inertial.iyz != 0)
+    {
+        // The principal axes would change the body frame
+        return -1;
+    }
+
+    std::map<std::pair<std::string, bool>, std::vector<size_t>>::iterator free_slot_ids_it = free_slot_ids.find({key, object.info.movable});
+    if (free_slot_ids_it == free_slot_ids.end() || free_slot_ids_it->second.empty())
+    {
+        return -1;
+    }
+
+    const size_t slot_id = free_slot_ids_it->second.back();
+    free_slot_ids_it->second.pop_back();
+
+    MjPoolSlot &slot = slots[slot_id];
+    slot.object_name = object.info.name;
+    slot.info = object.info;
+    slot.pose = object.pose;
+    object_slot_ids[slot.object_name] = slot_id;
+
+    activate(slot);
+    place(slot, object.pose, object.velocity);
+
+    return slot.body_id;
+}
+
+bool MjSpawnPool::release(const std::string &object_name)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    std::map<std::string, size_t>::iterator object_slot_ids_it = object_slot_ids.find(object_name);
+    if (object_slot_ids_it == object_slot_ids.end())
+    {
+        return false;
+    }
+
+    const size_t slot_id = object_slot_ids_it->second;
+    object_slot_ids.erase(object_slot_ids_it);
+
+    MjPoolSlot &slot = slots[slot_id];
+    slot.object_name.clear();
+    if (slot.body_id != -1)
+    {
+        deactivate(slot);
+        place(slot, get_park_pose(), geometry_msgs::Twist());
+        free_slot_ids[{slot.key, slot.movable}].push_back(slot_id);
+    }
+
+    return true;
+}
+
+bool MjSpawnPool::adopt(const std::string &object_name, const mujoco_msgs::ObjectInfo &info)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    const std::string key = get_key(info);
+    const int body_id = MjNameRegistry::get_instance().get_id(mjtObj::mjOBJ_BODY, object_name);
+    if (key.empty() || body_id < 1 || m->body_parentid[body_id] != 0 || slot_ids.count(object_name) != 0)
+    {
+        return false;
+    }
+
+    const bool is_template = info.type == mujoco_msgs::ObjectInfo::MESH;
+    const bool movable = m->body_mocapid[body_id] == -1;
+    if (is_template ? !movable : m->body_geomnum[body_id] != 1)
+    {
+        // Claims expect the layout of the slots the pool compiles itself
+        return false;
+    }
+
+    if (is_template && is_scaled(info))
+    {
+        // The template key doesn't know the scale the mesh was compiled with
+        return false;
+    }
+
+    const size_t slot_id = slots.size();
+    MjPoolSlot slot;
+    slot.slot_name = object_name;
+    slot.key = key;
+    slot.movable = movable;
+    slot.info = info;
+    slot.adopted = true;
+    slot.body_id = body_id;
+
+    body_slot_ids.resize(m->nbody, -1);
+    for (int child_body_id = body_id; child_body_id < m->nbody; child_body_id++)
+    {
+        if (m->body_rootid[child_body_id] != body_id)
+        {
+            continue;
+        }
+
+        body_slot_ids[child_body_id] = slot_id;
+        slot.body_ids.push_back(child_body_id);
+        for (int geom_id = m->body_geomadr[child_body_id]; geom_id < m->body_geomadr[child_body_id] + m->body_geomnum[child_body_id]; geom_id++)
+        {
+            geom_collisions[geom_id] = {m->geom_contype[geom_id], m->geom_conaffinity[geom_id]};
+        }
+    }
+
+    slot_ids[slot.slot_name] = slot_id;
+    slots.push_back(slot);
+
+    deactivate(slots.back());
+    place(slots.back(), get_park_pose(), geometry_msgs::Twist());
+    free_slot_ids[{slot.key, slot.movable}].push_back(slot_id);
+
+    return true;
+}
+
+std::vector<MjPoolSlot> MjSpawnPool::remove_adopted_slots(const std::set<std::string> &slot_names)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    std::vector<MjPoolSlot> removed_slots;
+    std::vector<MjPoolSlot> kept_slots;
+    kept_slots.reserve(slots.size());
+    for (MjPoolSlot &slot : slots)
+    {
+        if (slot.adopted && slot.object_name.empty() && (slot_names.empty() || slot_names.count(slot.slot_name) != 0))
+        {
+            removed_slots.push_back(std::move(slot));
+        }
+        else
+        {
+            kept_slots.push_back(std::move(slot));
+        }
+    }
+
+    slots.swap(kept_slots);
+    if (!removed_slots.empty())
+    {
+        rebuild_ids();
+    }
+    return removed_slots;
+}
+
+void MjSpawnPool::restore_adopted_slots(const std::vector<MjPoolSlot> &removed_slots)
+{
+    if (removed_slots.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(pool_mtx);
+        slots.insert(slots.end(), removed_slots.begin(), removed_slots.end());
+        rebuild_ids();
+    }
+
+    // Other edits may have recompiled the model in the meantime, so the body ids are resolved again
+    bind();
+}
+
+double MjSpawnPool::get_dead_body_ratio()
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    if (m->nbody < 2)
+    {
+        return 0.0;
+    }
+
+    size_t dead_body_num = 0;
+    for (const MjPoolSlot &slot : slots)
+    {
+        if (slot.adopted && slot.object_name.empty())
+        {
+            dead_body_num += slot.body_ids.size();
+        }
+    }
+    return (double)dead_body_num / (m->nbody - 1);
+}
+
+int MjSpawnPool::get_body_id(const std::string &object_name)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    std::map<std::string, size_t>::const_iterator object_slot_ids_it = object_slot_ids.find(object_name);
+    return object_slot_ids_it == object_slot_ids.end() ? -1 : slots[object_slot_ids_it->second].body_id;
+}
+
+bool MjSpawnPool::get_object_name(const int body_id, std::string &object_name)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    if (body_id < 0 || body_id >= (int)body_slot_ids.size() || body_slot_ids[body_id] == -1)
+    {
+        return false;
+    }
+
+    const MjPoolSlot &slot = slots[body_slot_ids[body_id]];
+    if (slot.body_id != body_id || slot.object_name.empty())
+    {
+        return false;
+    }
+
+    object_name = slot.object_name;
+    return true;
+}
+
+bool MjSpawnPool::is_free_slot(const int body_id)
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    return body_id >= 0 && body_id < (int)body_slot_ids.size() && body_slot_ids[body_id] != -1 && slots[body_slot_ids[body_id]].object_name.empty();
+}
+
+bool MjSpawnPool::is_slot_name(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    return slot_ids.find(name) != slot_ids.end();
+}
+
+bool MjSpawnPool::is_reserved_name(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    std::map<std::string, size_t>::const_iterator slot_ids_it = slot_ids.find(name);
+    return slot_ids_it != slot_ids.end() && !slots[slot_ids_it->second].adopted;
+}
+
+bool MjSpawnPool::empty() const
+{
+    std::lock_guard<std::mutex> lk(pool_mtx);
+    return slots.empty();
+}
+
+void MjSpawnPool::activate(const MjPoolSlot &slot)
+{
+    const mujoco_msgs::ObjectInfo &info = slot.info;
+    const bool is_template = info.type == mujoco_msgs::ObjectInfo::MESH;
+    for (const int body_id : slot.body_ids)
+    {
+        if (m->body_gravcomp[body_id] != 0)
+        {
+            m->body_gravcomp[body_id] = 0;
+            m->ngravcomp--;
+        }
+        for (int geom_id = m->body_geomadr[body_id]; geom_id < m->body_geomadr[body_id] + m->body_geomnum[body_id]; geom_id++)
+        {
+            m->geom_contype[geom_id] = geom_collisions[geom_id].first;
+            m->geom_conaffinity[geom_id] = geom_collisions[geom_id].second;
+            if (!is_template || !is_zero(info.rgba))
+            {
+                m->geom_rgba[4 * geom_id] = info.rgba.r;
+                m->geom_rgba[4 * geom_id + 1] = info.rgba.g;
+                m->geom_rgba[4 * geom_id + 2] = info.rgba.b;
+                m->geom_rgba[4 * geom_id + 3] = info.rgba.a;
+            }
+        }
+    }
+
+    if (is_template || m->body_geomnum[slot.body_id] != 1)
+    {
+        return;
+    }
+
+    // Write the geometry and the inertia of the primitive
+    const int body_id = slot.body_id;
+    const int geom_id = m->body_geomadr[body_id];
+    mjtNum *geom_size = m->geom_size + 3 * geom_id;
+    mjtNum mass = 0.0;
+    mjtNum inertia[3] = {0.0, 0.0, 0.0};
+    switch (m->geom_type[geom_id])
+    {
+    case mjtGeom::mjGEOM_BOX:
+        geom_size[0] = info.size.x;
+        geom_size[1] = info.size.y;
+        geom_size[2] = info.size.z;
+        m->geom_rbound[geom_id] = mju_sqrt(info.size.x * info.size.x + info.size.y * info.size.y + info.size.z * info.size.z);
+        mass = density * 8 * info.size.x * info.size.y * info.size.z;
+        inertia[0] = mass / 3 * (info.size.y * info.size.y + info.size.z * info.size.z);
+        inertia[1] = mass / 3 * (info.size.x * info.size.x + info.size.z * info.size.z);
+        inertia[2] = mass / 3 * (info.size.x * info.size.x + info.size.y * info.size.y);
+        break;
+
+    case mjtGeom::mjGEOM_SPHERE:
+        geom_size[0] = info.size.x;
+        m->geom_rbound[geom_id] = info.size.x;
+        mass = density * 4 / 3 * mjPI * info.size.x * info.size.x * info.size.x;
+        inertia[0] = 0.4 * mass * info.size.x * info.size.x;
+        inertia[1] = inertia[0];
+        inertia[2] = inertia[0];
+        break;
+
+    case mjtGeom::mjGEOM_CYLINDER:
+        geom_size[0] = info.size.x;
+        geom_size[1] = info.size.z;
+        m->geom_rbound[geom_id] = mju_sqrt(info.size.x * info.size.x + info.size.z * info.size.z);
+        mass = density * mjPI * info.size.x * info.size.x * 2 * info.size.z;
+        inertia[0] = mass * (3 * info.size.x * info.size.x + 4 * info.size.z * info.size.z) / 12;
+        inertia[1] = inertia[0];
+        inertia[2] = mass * info.size.x * info.size.x / 2;
+        break;
+
+    default:
+        return;
+    }
+
+    mjtNum ipos[3] = {0.0, 0.0, 0.0};
+    if (info.inertial.m != 0)
+    {
+        if (info.inertial.ixx != 0 || info.inertial.iyy != 0 || info.inertial.izz != 0)
+        {
+            inertia[0] = info.inertial.ixx;
+            inertia[1] = info.inertial.iyy;
+            inertia[2] = info.inertial.izz;
+        }
+        else if (mass > mjMINVAL)
+        {
+            mju_scl3(inertia, inertia, info.inertial.m / mass);
+        }
+        mass = info.inertial.m;
+        ipos[0] = info.inertial.com.x;
+        ipos[1] = info.inertial.com.y;
+        ipos[2] = info.inertial.com.z;
+    }
+
+    if (mass < mjMINVAL || inertia[0] < mjMINVAL || inertia[1] < mjMINVAL || inertia[2] < mjMINVAL)
+    {
+        ROS_WARN("Object [%s] has invalid inertia, keep the inertia of the slot", info.name.c_str());
+        return;
+    }
+
+    m->body_subtreemass[0] += mass - m->body_mass[body_id];
+    m->body_subtreemass[body_id] += mass - m->body_mass[body_id];
+    m->body_mass[body_id] = mass;
+    mju_copy3(m->body_inertia + 3 * body_id, inertia);
+    mju_copy3(m->body_ipos + 3 * body_id, ipos);
+    mju_unit4(m->body_iquat + 4 * body_id);
+
+    // Constants usually computed by mj_setConst, exact for a single free body
+    const mjtNum rot_invweight = (1 / inertia[0] + 1 / inertia[1] + 1 / inertia[2]) / 3;
+    m->body_invweight0[2 * body_id] = 1 / mass;
+    m->body_invweight0[2 * body_id + 1] = rot_invweight;
+    if (m->body_jntnum[body_id] == 1 && m->jnt_type[m->body_jntadr[body_id]] == mjtJoint::mjJNT_FREE)
+    {
+        const int dof_adr = m->jnt_dofadr[m->body_jntadr[body_id]];
+        for (int dof_nr = 0; dof_nr < 6; dof_nr++)
+        {
+            m->dof_invweight0[dof_adr + dof_nr] = dof_nr < 3 ? 1 / mass : rot_invweight;
+        }
+    }
+}
+
+void MjSpawnPool::deactivate(const MjPoolSlot &slot)
+{
+    for (const int body_id : slot.body_ids)
+    {
+        // Adopted bodies are compiled without gravity compensation, MuJoCo skips it if no body counts
+        if (m->body_gravcomp[body_id] == 0)
+        {
+            m->body_gravcomp[body_id] = 1;
+            m->ngravcomp++;
+        }
+        for (int geom_id = m->body_geomadr[body_id]; geom_id < m->body_geomadr[body_id] + m->body_geomnum[body_id]; geom_id++)
+        {
+            m->geom_contype[geom_id] = 0;
+            m->geom_conaffinity[geom_id] = 0;
+        }
+    }
+}
+
+void MjSpawnPool::place(const MjPoolSlot &slot, const geometry_msgs::Pose &pose, const geometry_msgs::Twist &velocity)
+{
+    const int body_id = slot.body_id;
+    mjtNum pos[3] = {pose.position.x, pose.position.y, pose.position.z};
+    mjtNum quat[4] = {pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z};
+    mju_normalize4(quat);
+
+    if (m->body_mocapid[body_id] != -1)
+    {
+        const int mocap_id = m->body_mocapid[body_id];
+        mju_copy3(d->mocap_pos + 3 * mocap_id, pos);
+        mju_copy4(d->mocap_quat + 4 * mocap_id, quat);
+    }
+    else if (m->body_jntnum[body_id] > 0 && m->jnt_type[m->body_jntadr[body_id]] == mjtJoint::mjJNT_FREE)
+    {
+        const int joint_id = m->body_jntadr[body_id];
+        const int qpos_adr = m->jnt_qposadr[joint_id];
+        const int dof_adr = m->jnt_dofadr[joint_id];
+        mju_copy3(d->qpos + qpos_adr, pos);
+        mju_copy4(d->qpos + qpos_adr + 3, quat);
+        d->qvel[dof_adr] = velocity.linear.x;
+        d->qvel[dof_adr + 1] = velocity.linear.y;
+        d->qvel[dof_adr + 2] = velocity.linear.z;
+        d->qvel[dof_adr + 3] = velocity.angular.x;
+        d->qvel[dof_adr + 4] = velocity.angular.y;
+        d->qvel[dof_adr + 5] = velocity.angular.z;
+    }
+
+    // Reset the internal joints of the subtree
+    for (const int child_body_id : slot.body_ids)
+    {
+        for (int joint_id = m->body_jntadr[child_body_id]; joint_id < m->body_jntadr[child_body_id] + m->body_jntnum[child_body_id]; joint_id++)
+        {
+            if (child_body_id == body_id && m->jnt_type[joint_id] == mjtJoint::mjJNT_FREE)
+            {
+                continue;
+            }
+            mju_copy(d->qpos + m->jnt_qposadr[joint_id], m->qpos0 + m->jnt_qposadr[joint_id], get_jnt_qpos_num(joint_id));
+            mju_zero(d->qvel + m->jnt_dofadr[joint_id], get_jnt_dof_num(joint_id));
+        }
+    }
+}
+
+void MjSpawnPool::rebuild_ids()
+{
+    slot_ids.clear();
+    object_slot_ids.clear();
+    free_slot_ids.clear();
+    body_slot_ids.assign(m->nbody, -1);
+    for (size_t slot_id = 0; slot_id < slots.size(); slot_id++)
+    {
+        const MjPoolSlot &slot = slots[slot_id];
+        slot_ids[slot.slot_name] = slot_id;
+        for (const int body_id : slot.body_ids)
+        {
+            body_slot_ids[body_id] = slot_id;
+        }
+
+        if (!slot.object_name.empty())
+        {
+            object_slot_ids[slot.object_name] = slot_id;
+        }
+        else if (slot.body_id != -1)
+        {
+            free_slot_ids[{slot.key, slot.movable}].push_back(slot_id);
+        }
+    }
+}
+
+std::string MjSpawnPool::get_key(const mujoco_msgs::ObjectInfo &info) const
+{
+    for (const std::pair<int, std::string> &primitive_type : primitive_types)
+    {
+        if (info.type == primitive_type.first)
+        {
+            return primitive_type.second;
+        }
+    }
+
+    if (info.type != mujoco_msgs::ObjectInfo::MESH)
+    {
+        return "";
+    }
+
+    boost::filesystem::path template_path = info.mesh;
+    if (template_path.extension().compare(".xml") != 0)
+    {
+        return "";
+    }
+    if (template_path.is_relative())
+    {
+        template_path = world_path.parent_path() / template_path;
+    }
+    return template_path.lexically_normal().string();
+}
@@ -0,0 +1,236 @@
+// Copyright (c) 2022, Hoang Giang Nguyen - Institute for Artificial Intelligence, University Bremen
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "mj_state_migration.h"
+#include "mj_name_registry.h"
+
+#include <cstring>
+#include <ros/ros.h>
+
+static int get_jnt_qpos_num(const mjModel *model, const int joint_id)
+{
+    switch (model->jnt_type[joint_id])
+    {
+    case mjtJoint::mjJNT_FREE:
+        return 7;
+
+    case mjtJoint::mjJNT_BALL:
+        return 4;
+
+    default:
+        return 1;
+    }
+}
+
+static int get_jnt_dof_num(const mjModel *model, const int joint_id)
+{
+    switch (model->jnt_type[joint_id])
+    {
+    case mjtJoint::mjJNT_FREE:
+        return 6;
+
+    case mjtJoint::mjJNT_BALL:
+        return 3;
+
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Get the address of the activation of every actuator, stateful actuators come after the stateless ones and have one activation each
+ *
+ */
+static std::vector<int> get_act_adrs(const mjModel *model)
+{
+    std::vector<int> act_adrs(model->nu, -1);
+    int act_adr = 0;
+    for (int actuator_id = 0; actuator_id < model->nu; actuator_id++)
+    {
+        if (model->actuator_dyntype[actuator_id] != mjtDyn::mjDYN_NONE)
+        {
+            act_adrs[actuator_id] = act_adr++;
+        }
+    }
+    return act_adrs;
+}
+
+MjStateMigration::MjStateMigration(const mjModel *in_m_old, const mjModel *in_m_new) : m_old(in_m_old), m_new(in_m_new)
+{
+    MjNameRegistry &mj_name_registry = MjNameRegistry::get_instance();
+
+    int mismatched_body_num = 0;
+    for (int body_id_old = 1; body_id_old < m_old->nbody; body_id_old++)
+    {
+        const char *name = mj_id2name(m_old, mjtObj::mjOBJ_BODY, body_id_old);
+        if (name == nullptr)
+        {
+            continue;
+        }
+
+        const int body_id_new = mj_name_registry.get_id(mjtObj::mjOBJ_BODY, name, m_new);
+        if (body_id_new == -1)
+        {
+            continue;
+        }
+
+        add_range(body_ranges, body_id_old, body_id_new, 1);
+
+        if (m_old->body_mocapid[body_id_old] != -1 && m_new->body_mocapid[body_id_new] != -1)
+        {
+            add_range(mocap_ranges, m_old->body_mocapid[body_id_old], m_new->body_mocapid[body_id_new], 1);
+        }
+
+        if (m_old->body_jntnum[body_id_old] != m_new->body_jntnum[body_id_new] || m_old->body_dofnum[body_id_old] != m_new->body_dofnum[body_id_new])
+        {
+            mismatched_body_num++;
+        }
+
+        add_joints(body_id_old, body_id_new);
+    }
+
+    if (mismatched_body_num > 0)
+    {
+        ROS_WARN("%d bodies changed their joints, only their joints with the same name and type keep their states", mismatched_body_num);
+    }
+
+    const std::vector<int> act_adrs_old = get_act_adrs(m_old);
+    const std::vector<int> act_adrs_new = get_act_adrs(m_new);
+    for (int actuator_id_old = 0; actuator_id_old < m_old->nu; actuator_id_old++)
+    {
+        const char *name = mj_id2name(m_old, mjtObj::mjOBJ_ACTUATOR, actuator_id_old);
+        if (name == nullptr || act_adrs_old[actuator_id_old] == -1)
+        {
+            continue;
+        }
+
+        const int actuator_id_new = mj_name_registry.get_id(mjtObj::mjOBJ_ACTUATOR, name, m_new);
+        if (actuator_id_new != -1 && act_adrs_new[actuator_id_new] != -1)
+        {
+            add_range(act_ranges, act_adrs_old[actuator_id_old], act_adrs_new[actuator_id_new], 1);
+        }
+    }
+
+    copy_sensordata = m_old->nsensordata == m_new->nsensordata;
+    if (!copy_sensordata)
+    {
+        ROS_WARN("Old model has %d sensors, new model has %d sensors, not supported, will be ignored...", m_old->nsensordata, m_new->nsensordata);
+    }
+}
+
+void MjStateMigration::add_range(std::vector<Range> &ranges, const int adr_old, const int adr_new, const int num)
+{
+    if (num <= 0)
+    {
+        return;
+    }
+
+    if (!ranges.empty())
+    {
+        Range &last_range = ranges.back();
+        if (last_range.adr_old + last_range.num == adr_old && last_range.adr_new + last_range.num == adr_new)
+        {
+            last_range.num += num;
+            return;
+        }
+    }
+    ranges.push_back({adr_old, adr_new, num});
+}
+
+void MjStateMigration::add_joints(const int body_id_old, const int body_id_new)
+{
+    const int jnt_num = m_old->body_jntnum[body_id_old];
+    bool same_joints = jnt_num == m_new->body_jntnum[body_id_new];
+    for (int jnt_nr = 0; same_joints && jnt_nr < jnt_num; jnt_nr++)
+    {
+        same_joints = m_old->jnt_type[m_old->body_jntadr[body_id_old] + jnt_nr] == m_new->jnt_type[m_new->body_jntadr[body_id_new] + jnt_nr];
+    }
+
+    if (same_joints)
+    {
+        // The joints of a body are contiguous in qpos and qvel
+        if (jnt_num > 0)
+        {
+            const int jnt_adr_old = m_old->body_jntadr[body_id_old];
+            const int jnt_adr_new = m_new->body_jntadr[body_id_new];
+            const int qpos_num = m_old->jnt_qposadr[jnt_adr_old + jnt_num - 1] + get_jnt_qpos_num(m_old, jnt_adr_old + jnt_num - 1) - m_old->jnt_qposadr[jnt_adr_old];
+            add_range(qpos_ranges, m_old->jnt_qposadr[jnt_adr_old], m_new->jnt_qposadr[jnt_adr_new], qpos_num);
+        }
+        add_range(dof_ranges, m_old->body_dofadr[body_id_old], m_new->body_dofadr[body_id_new], m_old->body_dofnum[body_id_old]);
+        return;
+    }
+
+    // Match the joints of the body by name
+    for (int jnt_nr_new = 0; jnt_nr_new < m_new->body_jntnum[body_id_new]; jnt_nr_new++)
+    {
+        const int joint_id_new = m_new->body_jntadr[body_id_new] + jnt_nr_new;
+        const char *name = mj_id2name(m_new, mjtObj::mjOBJ_JOINT, joint_id_new);
+        if (name == nullptr)
+        {
+            continue;
+        }
+        for (int jnt_nr_old = 0; jnt_nr_old < jnt_num; jnt_nr_old++)
+        {
+            const int joint_id_old = m_old->body_jntadr[body_id_old] + jnt_nr_old;
+            const char *name_old = mj_id2name(m_old, mjtObj::mjOBJ_JOINT, joint_id_old);
+            if (name_old != nullptr && strcmp(name, name_old) == 0 && m_old->jnt_type[joint_id_old] == m_new->jnt_type[joint_id_new])
+            {
+                add_range(qpos_ranges, m_old->jnt_qposadr[joint_id_old], m_new->jnt_qposadr[joint_id_new], get_jnt_qpos_num(m_new, joint_id_new));
+                add_range(dof_ranges, m_old->jnt_dofadr[joint_id_old], m_new->jnt_dofadr[joint_id_new], get_jnt_dof_num(m_new, joint_id_new));
+                break;
+            }
+        }
+    }
+}
+
+void MjStateMigration::copy(const std::vector<Range> &ranges, const mjtNum *src, mjtNum *dst, const int size)
+{
+    for (const Range &range : ranges)
+    {
+        mju_copy(dst + size * range.adr_new, src + size * range.adr_old, size * range.num);
+    }
+}
+
+void MjStateMigration::apply(const mjData *d_old, mjData *d_new) const
+{
+    d_new->time = d_old->time;
+
+    copy(body_ranges, d_old->xpos, d_new->xpos, 3);
+    copy(body_ranges, d_old->xquat, d_new->xquat, 4);
+    copy(body_ranges, d_old->xfrc_applied, d_new->xfrc_applied, 6);
+
+    copy(qpos_ranges, d_old->qpos, d_new->qpos, 1);
+
+    copy(dof_ranges, d_old->qvel, d_new->qvel, 1);
+    copy(dof_ranges, d_old->qacc, d_new->qacc, 1);
+    copy(dof_ranges, d_old->qacc_warmstart, d_new->qacc_warmstart, 1);
+    copy(dof_ranges, d_old->qfrc_applied, d_new->qfrc_applied, 1);
+
+    copy(act_ranges, d_old->act, d_new->act, 1);
+
+    copy(mocap_ranges, d_old->mocap_pos, d_new->mocap_pos, 3);
+    copy(mocap_ranges, d_old->mocap_quat, d_new->mocap_quat, 4);
+
+    if (copy_sensordata)
+    {
+        mju_copy(d_new->sensordata, d_old->sensordata, m_old->nsensordata);
+    }
+}
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+
+"""Spawn and destroy N objects per object type and record the latencies.
+
+Start the simulator first, then run e.g.
+    rosrun mujoco_sim benchmark_spawn_and_destroy.py --counts 10 100 1000 --output /tmp/spawn_benchmark
+to write /tmp/spawn_benchmark.csv and /tmp/spawn_benchmark.json.
+
+The stall time of the simulation thread and the real time factor are read from /mujoco/sim_stats,
+so pub_sim_stats_rate must not be 0.
+"""
+
+import argparse
+import csv
+import json
+import threading
+import time
+from math import ceil
+from typing import Dict, List
+
+import rospy
+from std_msgs.msg import ColorRGBA
+
+from mujoco_msgs.msg import ObjectStatus, ObjectInfo
+from mujoco_msgs.srv import SpawnObject, SpawnObjectRequest, DestroyObject, DestroyObjectRequest
+from mujoco_sim.msg import SimStats
+
+types = {
+    "cube": (ObjectInfo.CUBE, ""),
+    "sphere": (ObjectInfo.SPHERE, ""),
+    "cylinder": (ObjectInfo.CYLINDER, ""),
+    "box": (ObjectInfo.MESH, "box.xml"),
+    "cup": (ObjectInfo.MESH, "cup.xml"),
+}
+
+fields = ["type", "count", "operation", "calls", "failed_calls", "p50", "p90", "p99", "max", "mean",
+          "stall_time", "max_stall_time", "rtf_mean", "rtf_min", "rtf_idle"]
+
+
+class SimStatsRecorder:
+    def __init__(self) -> None:
+        self.lock = threading.Lock()
+        self.stats: List[SimStats] = []
+        self.sub = rospy.Subscriber("/mujoco/sim_stats", SimStats, self.callback, queue_size=100)
+
+    def callback(self, msg: SimStats) -> None:
+        with self.lock:
+            self.stats.append(msg)
+
+    def take(self) -> List[SimStats]:
+        with self.lock:
+            stats = self.stats
+            self.stats = []
+        return stats
+
+
+def percentile(values: List[float], p: float) -> float:
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, max(0, ceil(p / 100.0 * len(values)) - 1))]
+
+
+def make_object(name: str, object_type: str, mesh_dir: str, i: int, count: int) -> ObjectStatus:
+    object_status = ObjectStatus()
+    object_status.info.name = name
+    object_status.info.type, mesh = types[object_type]
+    object_status.info.movable = True
+    object_status.info.rgba = ColorRGBA(0, 0, 1, 1)
+    if mesh:
+        object_status.info.mesh = mesh_dir + "/" + mesh
+        object_status.info.size.x = 1
+        object_status.info.size.y = 1
+        object_status.info.size.z = 1
+    else:
+        object_status.info.size.x = 0.05
+        object_status.info.size.y = 0.05
+        object_status.info.size.z = 0.05
+
+    # Spread the objects on a grid so that they don't collide with each other
+    side = max(1, ceil(count ** 0.5))
+    object_status.pose.position.x = 0.3 * (i % side) - 0.15 * side
+    object_status.pose.position.y = 0.3 * (i // side) - 0.15 * side
+    object_status.pose.position.z = 5
+    object_status.pose.orientation.w = 1.0
+    return object_status
+
+
+def summarize(object_type: str, count: int, operation: str, latencies: List[float], failed_calls: int,
+              stats: List[SimStats], rtf_idle: float) -> Dict:
+    rtfs = [stat.real_time_factor for stat in stats]
+    return {
+        "type": object_type,
+        "count": count,
+        "operation": operation,
+        "calls": len(latencies),
+        "failed_calls": failed_calls,
+        "p50": percentile(latencies, 50),
+        "p90": percentile(latencies, 90),
+        "p99": percentile(latencies, 99),
+        "max": max(latencies) if latencies else 0.0,
+        "mean": sum(latencies) / len(latencies) if latencies else 0.0,
+        "stall_time": sum(stat.stall_time for stat in stats),
+        "max_stall_time": max((stat.max_stall_time for stat in stats), default=0.0),
+        "rtf_mean": sum(rtfs) / len(rtfs) if rtfs else 0.0,
+        "rtf_min": min(rtfs, default=0.0),
+        "rtf_idle": rtf_idle,
+    }
+
+
+def run(object_type: str, count: int, batch: int, mesh_dir: str, recorder: SimStatsRecorder,
+        idle_time: float) -> List[Dict]:
+    spawn_objects = rospy.ServiceProxy("/mujoco/spawn_objects", SpawnObject, persistent=True)
+    destroy_objects = rospy.ServiceProxy("/mujoco/destroy_objects", DestroyObject, persistent=True)
+
+    # Real time factor of the unloaded simulation
+    recorder.take()
+    rospy.sleep(idle_time)
+    idle_stats = recorder.take()
+    rtf_idle = sum(stat.real_time_factor for stat in idle_stats) / len(idle_stats) if idle_stats else 0.0
+
+    names = ["benchmark_" + object_type + "_" + str(i) for i in range(count)]
+    results = []
+    for operation in ["spawn", "destroy"]:
+        latencies = []
+        failed_calls = 0
+        recorder.take()
+        for start in range(0, count, batch):
+            if rospy.is_shutdown():
+                return results
+            batch_names = names[start:start + batch]
+            call_start = time.perf_counter()
+            try:
+                if operation == "spawn":
+                    request = SpawnObjectRequest()
+                    request.objects = [make_object(name, object_type, mesh_dir, start + i, count)
+                                       for i, name in enumerate(batch_names)]
+                    response = spawn_objects(request)
+                    succeeded = len(response.names) == len(batch_names)
+                else:
+                    request = DestroyObjectRequest()
+                    request.names = batch_names
+                    destroy_objects(request)
+                    succeeded = True
+            except rospy.ServiceException as error:
+                rospy.logwarn(f"Service call failed: {error}")
+                succeeded = False
+            latencies.append((time.perf_counter() - call_start) * 1000.0)
+            failed_calls += 0 if succeeded else 1
+
+        # Let the last statistics of the phase arrive
+        rospy.sleep(0.2)
+        result = summarize(object_type, count, operation, latencies, failed_calls, recorder.take(), rtf_idle)
+        rospy.loginfo(f"{object_type} x {count} {operation}: p50 {result['p50']:.2f} ms, p99 {result['p99']:.2f} ms, "
+                      f"stall {result['stall_time']:.2f} ms, rtf {result['rtf_mean']:.2f} (idle {rtf_idle:.2f})")
+        results.append(result)
+    return results
+
+
+if __name__ == "__main__":
+    rospy.init_node("benchmark_spawn_and_destroy")
+    parser = argparse.ArgumentParser(description="Benchmark the spawn and destroy services")
+    parser.add_argument("--counts", type=int, nargs="+", default=[10, 100, 1000],
+                        help="Numbers of objects to spawn and destroy per type")
+    parser.add_argument("--types", nargs="+", default=list(types.keys()), choices=list(types.keys()),
+                        help="Object types to benchmark")
+    parser.add_argument("--batch", type=int, default=1, help="Objects per service call")
+    parser.add_argument("--mesh_dir", default="../test",
+                        help="Directory of box.xml and cup.xml, relative to the directory of the world")
+    parser.add_argument("--idle_time", type=float, default=2.0,
+                        help="Seconds to measure the real time factor without load before each run")
+    parser.add_argument("--output", default="spawn_benchmark", help="Path of the results without extension")
+    args = parser.parse_args(rospy.myargv()[1:])
+
+    rospy.wait_for_service("/mujoco/spawn_objects")
+    rospy.wait_for_service("/mujoco/destroy_objects")
+    recorder = SimStatsRecorder()
+
+    results = []
+    for object_type in args.types:
+        for count in args.counts:
+            results += run(object_type, count, max(1, args.batch), args.mesh_dir, recorder, args.idle_time)
+
+    with open(args.output + ".csv", "w", newline="") as csv_file:
+        writer = csv.DictWriter(csv_file, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(results)
+
+    with open(args.output + ".json", "w") as json_file:
+        json.dump({"batch": args.batch, "latency_unit": "ms", "results": results}, json_file, indent=2)
+
+    rospy.loginfo(f"Wrote {args.output}.csv and {args.output}.json")